@@ -0,0 +1,624 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+
+#define SEISCOMP_COMPONENT MapView
+#include <seiscomp/logging/log.h>
+#include <seiscomp/datamodel/event.h>
+#include <seiscomp/datamodel/focalmechanism.h>
+#include <seiscomp/datamodel/magnitude.h>
+#include <seiscomp/datamodel/momenttensor.h>
+#include <seiscomp/datamodel/origin.h>
+#include <seiscomp/datamodel/originreference.h>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "eventcatalogcache.h"
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+namespace Seiscomp {
+namespace MapViewX {
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+namespace {
+
+
+const char CacheMagic[8] = {'S', 'C', 'M', 'V', 'X', 'C', 'A', 'T'};
+const quint32 CacheVersion = 3;
+const quint32 NoString = 0xFFFFFFFF;
+const float NoValue = std::numeric_limits<float>::quiet_NaN();
+const qint8 NoEnum = -1;
+
+
+struct Header {
+	char     magic[8];
+	quint32  version;
+	quint32  count;
+	qint64   sourceSize;
+	//! The modification time of the input file in ms since epoch
+	qint64   sourceModified;
+	quint64  stringsOffset;
+	quint64  stringsSize;
+};
+
+
+struct Record {
+	qint64   seconds;
+	double   latitude;
+	double   longitude;
+	qint32   microseconds;
+	//! The depth in km or NaN
+	float    depth;
+	//! The magnitude or NaN
+	float    magnitude;
+	//! The nodal plane or NaN
+	float    strike;
+	float    dip;
+	float    rake;
+	//! Offsets into the string table or NoString
+	quint32  eventID;
+	quint32  originID;
+	quint32  magnitudeID;
+	quint32  magnitudeType;
+	quint32  focalMechanismID;
+	quint32  eventAgencyID;
+	quint32  eventAuthor;
+	quint32  originAgencyID;
+	quint32  originAuthor;
+	//! The enumeration values or NoEnum
+	qint8    eventType;
+	qint8    evaluationMode;
+	qint8    evaluationStatus;
+	qint8    reserved;
+	//! The origin quality or NaN and -1
+	float    standardError;
+	qint32   usedPhaseCount;
+	//! The moment tensor of the focal mechanism, its derived origin and
+	//! moment magnitude
+	quint32  momentTensorID;
+	quint32  derivedOriginID;
+	quint32  momentMagnitudeID;
+	qint32   derivedMicroseconds;
+	qint64   derivedSeconds;
+	double   derivedLatitude;
+	double   derivedLongitude;
+	//! The depth of the derived origin in km or NaN
+	float    derivedDepth;
+	//! The moment magnitude or NaN
+	float    momentMagnitude;
+};
+
+
+static_assert(sizeof(Header) == 48, "Unexpected cache header size");
+static_assert(sizeof(Record) == 144, "Unexpected cache record size");
+
+
+class StringTable {
+	public:
+		quint32 add(const std::string &str) {
+			if ( str.empty() ) {
+				return NoString;
+			}
+
+			auto offset = static_cast<quint32>(_data.size());
+			auto length = static_cast<quint16>(std::min<size_t>(str.size(), 0xFFFF));
+			_data.append(reinterpret_cast<const char*>(&length), sizeof(length));
+			_data.append(str.data(), length);
+			return offset;
+		}
+
+		const QByteArray &data() const { return _data; }
+
+	private:
+		QByteArray _data;
+};
+
+
+bool readString(const uchar *strings, quint64 size, quint32 offset,
+                std::string &str) {
+	str.clear();
+
+	if ( offset == NoString ) {
+		return true;
+	}
+
+	quint64 begin = offset;
+	if ( begin + sizeof(quint16) > size ) {
+		return false;
+	}
+
+	quint16 length;
+	memcpy(&length, strings + begin, sizeof(length));
+	begin += sizeof(length);
+
+	if ( begin + length > size ) {
+		return false;
+	}
+
+	str.assign(reinterpret_cast<const char*>(strings + begin), length);
+	return true;
+}
+
+
+template <typename T>
+void setCreationInfo(T *obj, const std::string &agencyID,
+                     const std::string &author) {
+	if ( agencyID.empty() && author.empty() ) {
+		return;
+	}
+
+	DataModel::CreationInfo ci;
+	ci.setAgencyID(agencyID);
+	ci.setAuthor(author);
+	obj->setCreationInfo(ci);
+}
+
+
+template <typename T>
+void addCreationInfo(StringTable &strings, const T *obj, quint32 &agencyID,
+                     quint32 &author) {
+	agencyID = author = NoString;
+
+	try {
+		agencyID = strings.add(obj->creationInfo().agencyID());
+		author = strings.add(obj->creationInfo().author());
+	}
+	catch ( Core::ValueException& ) {}
+}
+
+
+// Selects the nodal plane in the same way as the event layer
+const DataModel::NodalPlane *nodalPlane(const DataModel::FocalMechanism *fm) {
+	int preferredNodalPlane = 0;
+
+	try {
+		preferredNodalPlane = fm->nodalPlanes().preferredPlane();
+	}
+	catch ( Core::ValueException& ) {}
+
+	try {
+		if ( preferredNodalPlane == 0 ) {
+			return &(fm->nodalPlanes().nodalPlane1());
+		}
+		else {
+			return &(fm->nodalPlanes().nodalPlane2());
+		}
+	}
+	catch ( Core::ValueException& ) {}
+
+	return nullptr;
+}
+
+
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+std::string EventCatalogCache::cacheFile(const std::string &inputFile) {
+	return inputFile + ".scmvx";
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+DataModel::EventParametersPtr EventCatalogCache::read(const std::string &inputFile) {
+	QFileInfo source(QString::fromStdString(inputFile));
+	QFile file(QString::fromStdString(cacheFile(inputFile)));
+
+	if ( !source.exists() || !file.open(QIODevice::ReadOnly) ) {
+		return nullptr;
+	}
+
+	qint64 size = file.size();
+	if ( size < static_cast<qint64>(sizeof(Header)) ) {
+		return nullptr;
+	}
+
+	const uchar *data = file.map(0, size);
+	if ( !data ) {
+		return nullptr;
+	}
+
+	Header header;
+	memcpy(&header, data, sizeof(header));
+
+	if ( memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) != 0
+	  || header.version != CacheVersion ) {
+		return nullptr;
+	}
+
+	if ( header.sourceSize != source.size()
+	  || header.sourceModified != source.lastModified().toMSecsSinceEpoch() ) {
+		SEISCOMP_INFO("Cache of %s is outdated", inputFile.c_str());
+		return nullptr;
+	}
+
+	if ( header.stringsOffset != sizeof(Header) + quint64(header.count) * sizeof(Record)
+	  || header.stringsOffset + header.stringsSize != quint64(size) ) {
+		SEISCOMP_WARNING("Cache of %s is corrupt", inputFile.c_str());
+		return nullptr;
+	}
+
+	const uchar *records = data + sizeof(Header);
+	const uchar *strings = data + header.stringsOffset;
+
+	DataModel::EventParametersPtr ep = new DataModel::EventParameters;
+	std::string eventID, originID, magnitudeID, magnitudeType, focalMechanismID;
+	std::string eventAgencyID, eventAuthor, originAgencyID, originAuthor;
+	std::string momentTensorID, derivedOriginID, momentMagnitudeID;
+
+	for ( quint32 i = 0; i < header.count; ++i ) {
+		Record record;
+		memcpy(&record, records + quint64(i) * sizeof(Record), sizeof(record));
+
+		if ( !readString(strings, header.stringsSize, record.eventID, eventID)
+		  || !readString(strings, header.stringsSize, record.originID, originID)
+		  || !readString(strings, header.stringsSize, record.magnitudeID, magnitudeID)
+		  || !readString(strings, header.stringsSize, record.magnitudeType, magnitudeType)
+		  || !readString(strings, header.stringsSize, record.focalMechanismID, focalMechanismID)
+		  || !readString(strings, header.stringsSize, record.eventAgencyID, eventAgencyID)
+		  || !readString(strings, header.stringsSize, record.eventAuthor, eventAuthor)
+		  || !readString(strings, header.stringsSize, record.originAgencyID, originAgencyID)
+		  || !readString(strings, header.stringsSize, record.originAuthor, originAuthor)
+		  || !readString(strings, header.stringsSize, record.momentTensorID, momentTensorID)
+		  || !readString(strings, header.stringsSize, record.derivedOriginID, derivedOriginID)
+		  || !readString(strings, header.stringsSize, record.momentMagnitudeID, momentMagnitudeID)
+		  || eventID.empty() || originID.empty() ) {
+			SEISCOMP_WARNING("Cache of %s is corrupt", inputFile.c_str());
+			return nullptr;
+		}
+
+		DataModel::OriginPtr org = new DataModel::Origin(originID);
+		org->setTime(Core::Time(record.seconds, record.microseconds));
+		org->setLatitude(record.latitude);
+		org->setLongitude(record.longitude);
+		if ( !std::isnan(record.depth) ) {
+			org->setDepth(DataModel::RealQuantity(record.depth));
+		}
+		if ( record.evaluationMode != NoEnum ) {
+			org->setEvaluationMode(DataModel::EvaluationMode(
+				static_cast<DataModel::EEvaluationMode>(record.evaluationMode)
+			));
+		}
+		if ( record.evaluationStatus != NoEnum ) {
+			org->setEvaluationStatus(DataModel::EvaluationStatus(
+				static_cast<DataModel::EEvaluationStatus>(record.evaluationStatus)
+			));
+		}
+		setCreationInfo(org.get(), originAgencyID, originAuthor);
+
+		if ( !std::isnan(record.standardError) || record.usedPhaseCount >= 0 ) {
+			DataModel::OriginQuality quality;
+			if ( !std::isnan(record.standardError) ) {
+				quality.setStandardError(record.standardError);
+			}
+			if ( record.usedPhaseCount >= 0 ) {
+				quality.setUsedPhaseCount(record.usedPhaseCount);
+			}
+			org->setQuality(quality);
+		}
+
+		if ( !magnitudeID.empty() ) {
+			DataModel::MagnitudePtr mag = new DataModel::Magnitude(magnitudeID);
+			mag->setMagnitude(DataModel::RealQuantity(record.magnitude));
+			mag->setType(magnitudeType);
+			org->add(mag.get());
+		}
+
+		ep->add(org.get());
+
+		if ( !focalMechanismID.empty() ) {
+			DataModel::FocalMechanismPtr fm = new DataModel::FocalMechanism(focalMechanismID);
+			fm->setTriggeringOriginID(originID);
+
+			if ( !std::isnan(record.strike) ) {
+				DataModel::NodalPlane np;
+				np.setStrike(DataModel::RealQuantity(record.strike));
+				np.setDip(DataModel::RealQuantity(record.dip));
+				np.setRake(DataModel::RealQuantity(record.rake));
+
+				DataModel::NodalPlanes planes;
+				planes.setNodalPlane1(np);
+				fm->setNodalPlanes(planes);
+			}
+
+			if ( !momentTensorID.empty() ) {
+				DataModel::MomentTensorPtr mt = new DataModel::MomentTensor(momentTensorID);
+				mt->setDerivedOriginID(derivedOriginID);
+				mt->setMomentMagnitudeID(momentMagnitudeID);
+				fm->add(mt.get());
+
+				// The derived origin and the moment magnitude place and
+				// scale the beach ball
+				DataModel::Origin *derived = org.get();
+				if ( !derivedOriginID.empty() && derivedOriginID != originID ) {
+					DataModel::OriginPtr derivedOrg = new DataModel::Origin(derivedOriginID);
+					derivedOrg->setTime(Core::Time(record.derivedSeconds, record.derivedMicroseconds));
+					derivedOrg->setLatitude(record.derivedLatitude);
+					derivedOrg->setLongitude(record.derivedLongitude);
+					if ( !std::isnan(record.derivedDepth) ) {
+						derivedOrg->setDepth(DataModel::RealQuantity(record.derivedDepth));
+					}
+					ep->add(derivedOrg.get());
+					derived = derivedOrg.get();
+				}
+
+				if ( !momentMagnitudeID.empty() && momentMagnitudeID != magnitudeID ) {
+					DataModel::MagnitudePtr mw = new DataModel::Magnitude(momentMagnitudeID);
+					mw->setMagnitude(DataModel::RealQuantity(record.momentMagnitude));
+					mw->setType("Mw");
+					derived->add(mw.get());
+				}
+			}
+
+			ep->add(fm.get());
+		}
+
+		DataModel::EventPtr evt = new DataModel::Event(eventID);
+		evt->setPreferredOriginID(originID);
+		evt->setPreferredMagnitudeID(magnitudeID);
+		evt->setPreferredFocalMechanismID(focalMechanismID);
+		if ( record.eventType != NoEnum ) {
+			evt->setType(DataModel::EventType(
+				static_cast<DataModel::EEventType>(record.eventType)
+			));
+		}
+		setCreationInfo(evt.get(), eventAgencyID, eventAuthor);
+		evt->add(new DataModel::OriginReference(originID));
+		ep->add(evt.get());
+	}
+
+	SEISCOMP_INFO("Read %d events from cache of %s",
+	              static_cast<int>(header.count), inputFile.c_str());
+
+	return ep;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool EventCatalogCache::write(const std::string &inputFile,
+                              const DataModel::EventParameters *ep) {
+	QFileInfo source(QString::fromStdString(inputFile));
+	if ( !source.exists() ) {
+		return false;
+	}
+
+	std::vector<Record> records;
+	StringTable strings;
+
+	records.reserve(ep->eventCount());
+
+	// Look up objects in hash indexes of the parsed tree. The global
+	// object registry must not be accessed from the reader thread and the
+	// find methods of EventParameters scan the children linearly.
+	std::unordered_map<std::string, DataModel::Origin*> origins;
+	std::unordered_map<std::string, DataModel::Magnitude*> magnitudes;
+	std::unordered_map<std::string, DataModel::FocalMechanism*> focalMechanisms;
+
+	origins.reserve(ep->originCount());
+	focalMechanisms.reserve(ep->focalMechanismCount());
+
+	for ( size_t i = 0; i < ep->originCount(); ++i ) {
+		DataModel::Origin *org = ep->origin(i);
+		origins[org->publicID()] = org;
+		for ( size_t j = 0; j < org->magnitudeCount(); ++j ) {
+			magnitudes[org->magnitude(j)->publicID()] = org->magnitude(j);
+		}
+	}
+
+	for ( size_t i = 0; i < ep->focalMechanismCount(); ++i ) {
+		DataModel::FocalMechanism *fm = ep->focalMechanism(i);
+		focalMechanisms[fm->publicID()] = fm;
+	}
+
+	for ( size_t i = 0; i < ep->eventCount(); ++i ) {
+		DataModel::Event *evt = ep->event(i);
+		auto orgIt = origins.find(evt->preferredOriginID());
+		if ( orgIt == origins.end() ) {
+			continue;
+		}
+
+		DataModel::Origin *org = orgIt->second;
+
+		Record record{};
+		const Core::Time &time = org->time().value();
+		record.seconds = time.seconds();
+		record.microseconds = time.microseconds();
+		record.latitude = org->latitude().value();
+		record.longitude = org->longitude().value();
+		record.depth = NoValue;
+		record.magnitude = NoValue;
+		record.strike = record.dip = record.rake = NoValue;
+
+		try {
+			record.depth = static_cast<float>(org->depth().value());
+		}
+		catch ( ... ) {}
+
+		record.eventID = strings.add(evt->publicID());
+		record.originID = strings.add(org->publicID());
+		record.magnitudeID = NoString;
+		record.magnitudeType = NoString;
+		record.focalMechanismID = NoString;
+		record.eventType = NoEnum;
+		record.evaluationMode = NoEnum;
+		record.evaluationStatus = NoEnum;
+		record.standardError = NoValue;
+		record.usedPhaseCount = -1;
+		record.momentTensorID = NoString;
+		record.derivedOriginID = NoString;
+		record.momentMagnitudeID = NoString;
+		record.derivedDepth = NoValue;
+		record.momentMagnitude = NoValue;
+
+		try {
+			record.standardError = static_cast<float>(org->quality().standardError());
+		}
+		catch ( Core::ValueException& ) {}
+
+		try {
+			record.usedPhaseCount = org->quality().usedPhaseCount();
+		}
+		catch ( Core::ValueException& ) {}
+
+		try {
+			record.eventType = static_cast<qint8>(evt->type());
+		}
+		catch ( Core::ValueException& ) {}
+
+		try {
+			record.evaluationMode = static_cast<qint8>(org->evaluationMode());
+		}
+		catch ( Core::ValueException& ) {}
+
+		try {
+			record.evaluationStatus = static_cast<qint8>(org->evaluationStatus());
+		}
+		catch ( Core::ValueException& ) {}
+
+		addCreationInfo(strings, evt, record.eventAgencyID, record.eventAuthor);
+		addCreationInfo(strings, org, record.originAgencyID, record.originAuthor);
+
+		auto magIt = magnitudes.find(evt->preferredMagnitudeID());
+		DataModel::Magnitude *mag = magIt != magnitudes.end() ? magIt->second : nullptr;
+
+		if ( mag ) {
+			record.magnitude = static_cast<float>(mag->magnitude().value());
+			record.magnitudeID = strings.add(mag->publicID());
+			record.magnitudeType = strings.add(mag->type());
+		}
+
+		auto fmIt = focalMechanisms.find(evt->preferredFocalMechanismID());
+		DataModel::FocalMechanism *fm = fmIt != focalMechanisms.end() ? fmIt->second : nullptr;
+		if ( fm ) {
+			record.focalMechanismID = strings.add(fm->publicID());
+
+			const DataModel::NodalPlane *np = nodalPlane(fm);
+			if ( np ) {
+				record.strike = static_cast<float>(np->strike().value());
+				record.dip = static_cast<float>(np->dip().value());
+				record.rake = static_cast<float>(np->rake().value());
+			}
+
+			if ( fm->momentTensorCount() > 0 ) {
+				DataModel::MomentTensor *mt = fm->momentTensor(0);
+				record.momentTensorID = strings.add(mt->publicID());
+				record.derivedOriginID = strings.add(mt->derivedOriginID());
+				record.momentMagnitudeID = strings.add(mt->momentMagnitudeID());
+
+				auto derivedIt = origins.find(mt->derivedOriginID());
+				if ( derivedIt != origins.end() ) {
+					DataModel::Origin *derived = derivedIt->second;
+					const Core::Time &derivedTime = derived->time().value();
+					record.derivedSeconds = derivedTime.seconds();
+					record.derivedMicroseconds = derivedTime.microseconds();
+					record.derivedLatitude = derived->latitude().value();
+					record.derivedLongitude = derived->longitude().value();
+
+					try {
+						record.derivedDepth = static_cast<float>(derived->depth().value());
+					}
+					catch ( ... ) {}
+				}
+				else {
+					// Not available, the beach ball is drawn at the
+					// preferred origin
+					record.derivedOriginID = NoString;
+				}
+
+				auto mwIt = magnitudes.find(mt->momentMagnitudeID());
+				if ( mwIt != magnitudes.end() ) {
+					try {
+						record.momentMagnitude = static_cast<float>(mwIt->second->magnitude().value());
+					}
+					catch ( ... ) {
+						record.momentMagnitudeID = NoString;
+					}
+				}
+				else {
+					record.momentMagnitudeID = NoString;
+				}
+			}
+		}
+
+		records.push_back(record);
+	}
+
+	Header header{};
+	memcpy(header.magic, CacheMagic, sizeof(header.magic));
+	header.version = CacheVersion;
+	header.count = static_cast<quint32>(records.size());
+	header.sourceSize = source.size();
+	header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+	header.stringsOffset = sizeof(Header) + records.size() * sizeof(Record);
+	header.stringsSize = static_cast<quint64>(strings.data().size());
+
+	QSaveFile file(QString::fromStdString(cacheFile(inputFile)));
+	if ( !file.open(QIODevice::WriteOnly) ) {
+		SEISCOMP_DEBUG("Unable to create cache of %s: %s", inputFile.c_str(),
+		               qPrintable(file.errorString()));
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(records.data()),
+	           static_cast<qint64>(records.size() * sizeof(Record)));
+	file.write(strings.data());
+
+	if ( !file.commit() ) {
+		SEISCOMP_WARNING("Unable to write cache of %s: %s", inputFile.c_str(),
+		                 qPrintable(file.errorString()));
+		return false;
+	}
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
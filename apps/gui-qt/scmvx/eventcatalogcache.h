@@ -0,0 +1,74 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+
+#ifndef SEISCOMP_MAPVIEWX_EVENTCATALOGCACHE_H
+#define SEISCOMP_MAPVIEWX_EVENTCATALOGCACHE_H
+
+
+#include <seiscomp/datamodel/eventparameters.h>
+
+#include <string>
+
+
+namespace Seiscomp {
+namespace MapViewX {
+
+
+/**
+ * @brief Binary cache of the events of an XML file.
+ *
+ * The cache stores only what the map and the event list need for each
+ * event: the public IDs, the preferred origin time, location, evaluation
+ * state and quality, the preferred magnitude, the nodal plane of the
+ * preferred focal mechanism, the derived origin and moment magnitude of its
+ * moment tensor, the event type and the agency and author of the event and
+ * the origin. It consists of a header, an array of fixed size records and
+ * a table of length prefixed strings and is read through a memory mapping.
+ * A cache is only used if the size and the modification time of the input
+ * file match the values recorded in the header.
+ */
+class EventCatalogCache {
+	public:
+		//! Returns the path of the cache file of an input file
+		static std::string cacheFile(const std::string &inputFile);
+
+		/**
+		 * @brief Creates EventParameters from the cache of an input file.
+		 * @return The event parameters or nullptr if no valid cache
+		 *         exists
+		 */
+		static DataModel::EventParametersPtr read(const std::string &inputFile);
+
+		/**
+		 * @brief Writes the cache of an input file. The file is replaced
+		 *        atomically.
+		 * @return Whether the cache has been written
+		 */
+		static bool write(const std::string &inputFile,
+		                  const DataModel::EventParameters *ep);
+};
+
+
+}
+}
+
+
+#endif
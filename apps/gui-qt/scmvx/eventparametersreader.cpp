@@ -0,0 +1,216 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+
+#define SEISCOMP_COMPONENT MapView
+#include <seiscomp/logging/log.h>
+#include <seiscomp/datamodel/amplitude.h>
+#include <seiscomp/datamodel/magnitude.h>
+#include <seiscomp/datamodel/origin.h>
+#include <seiscomp/datamodel/pick.h>
+#include <seiscomp/datamodel/visitor.h>
+#include <seiscomp/io/archive/xmlarchive.h>
+
+#include "eventcatalogcache.h"
+#include "eventparametersreader.h"
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+namespace Seiscomp {
+namespace MapViewX {
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+namespace {
+
+
+// The registration flag of public objects is thread local. Objects created
+// by the reader thread are not added to the global registry which is not
+// synchronized.
+class RegistrationGuard {
+	public:
+		RegistrationGuard() {
+			DataModel::PublicObject::SetRegistrationEnabled(false);
+		}
+
+		~RegistrationGuard() {
+			DataModel::PublicObject::SetRegistrationEnabled(true);
+		}
+};
+
+
+class Registrar : public DataModel::Visitor {
+	public:
+		bool visit(DataModel::PublicObject *po) override {
+			if ( !po->registerMe() ) {
+				++failed;
+			}
+			return true;
+		}
+
+		void visit(DataModel::Object *) override {}
+
+	public:
+		int failed{0};
+};
+
+
+// Children are removed from the back to avoid shifting the remaining
+// elements
+void discardDetails(DataModel::EventParameters *ep) {
+	for ( size_t i = ep->pickCount(); i > 0; --i ) {
+		ep->removePick(i - 1);
+	}
+
+	for ( size_t i = ep->amplitudeCount(); i > 0; --i ) {
+		ep->removeAmplitude(i - 1);
+	}
+
+	for ( size_t i = 0; i < ep->originCount(); ++i ) {
+		DataModel::Origin *org = ep->origin(i);
+
+		for ( size_t j = org->arrivalCount(); j > 0; --j ) {
+			org->removeArrival(j - 1);
+		}
+
+		for ( size_t j = org->stationMagnitudeCount(); j > 0; --j ) {
+			org->removeStationMagnitude(j - 1);
+		}
+
+		for ( size_t j = 0; j < org->magnitudeCount(); ++j ) {
+			DataModel::Magnitude *mag = org->magnitude(j);
+
+			for ( size_t k = mag->stationMagnitudeContributionCount(); k > 0; --k ) {
+				mag->removeStationMagnitudeContribution(k - 1);
+			}
+		}
+	}
+}
+
+
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+EventParametersReader::EventParametersReader(const std::string &file,
+                                             bool discardDetails,
+                                             bool useCache,
+                                             QObject *parent)
+: QThread(parent)
+, _file(file)
+, _discardDetails(discardDetails)
+, _useCache(useCache) {}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventParametersReader::discard() {
+	cancel();
+	disconnect();
+	connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
+
+	// The thread might have finished before the connection was made
+	if ( isFinished() ) {
+		deleteLater();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventParametersReader::run() {
+	RegistrationGuard guard;
+
+	if ( _useCache ) {
+		// The cache holds no details, nothing to discard
+		_ep = EventCatalogCache::read(_file);
+		if ( _ep ) {
+			return;
+		}
+	}
+
+	IO::XMLArchive ar;
+	if ( !ar.open(_file.c_str()) ) {
+		_errorString = QString("Could not open file\n%1").arg(_file.c_str());
+		return;
+	}
+
+	DataModel::EventParametersPtr ep;
+	ar >> ep;
+	ar.close();
+
+	if ( !ep ) {
+		_errorString = QString("Invalid file\n%1").arg(_file.c_str());
+		return;
+	}
+
+	if ( _canceled ) {
+		return;
+	}
+
+	if ( _useCache ) {
+		EventCatalogCache::write(_file, ep.get());
+	}
+
+	if ( _discardDetails ) {
+		discardDetails(ep.get());
+	}
+
+	_ep = ep;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventParametersReader::registerObjects() {
+	if ( !_ep ) {
+		return;
+	}
+
+	Registrar registrar;
+	_ep->accept(&registrar);
+
+	if ( registrar.failed > 0 ) {
+		SEISCOMP_WARNING("%d objects of %s have not been registered, their "
+		                 "public IDs are already in use", registrar.failed,
+		                 _file.c_str());
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -0,0 +1,109 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+
+#ifndef SEISCOMP_MAPVIEWX_EVENTPARAMETERSREADER_H
+#define SEISCOMP_MAPVIEWX_EVENTPARAMETERSREADER_H
+
+
+#ifndef Q_MOC_RUN
+#include <seiscomp/datamodel/eventparameters.h>
+#endif
+
+#include <QString>
+#include <QThread>
+
+#include <atomic>
+#include <string>
+
+
+namespace Seiscomp {
+namespace MapViewX {
+
+
+/**
+ * @brief Reads EventParameters from an XML file in a worker thread.
+ *
+ * The result is available after the thread has finished. Optionally all
+ * objects not required to display the events are discarded from the
+ * object tree before it is handed over to reduce its memory footprint:
+ * picks, amplitudes, arrivals, station magnitudes and station magnitude
+ * contributions.
+ *
+ * If enabled, the events are read from a binary cache next to the input
+ * file if it is up to date. Otherwise the cache is written after the file
+ * has been parsed.
+ *
+ * The objects are created with registration disabled because the global
+ * public object registry must only be accessed from the GUI thread. After
+ * the thread has finished, registerObjects() must be called from the GUI
+ * thread before the objects are used.
+ */
+class EventParametersReader : public QThread {
+	Q_OBJECT
+
+	public:
+		//! The reader must not be deleted while the thread is running,
+		//! use discard() to release a running reader
+		EventParametersReader(const std::string &file, bool discardDetails,
+		                      bool useCache, QObject *parent = nullptr);
+
+	public:
+		//! Requests to stop reading, the result of a canceled read is
+		//! discarded
+		void cancel() { _canceled = true; }
+		bool isCanceled() const { return _canceled; }
+
+		/**
+		 * @brief Cancels reading and detaches the reader from all
+		 *        receivers. The parser cannot be interrupted, the reader
+		 *        deletes itself when the thread has finished. It must not
+		 *        have a parent.
+		 */
+		void discard();
+
+		const std::string &file() const { return _file; }
+
+		//! Returns the result or nullptr if reading failed or has been
+		//! canceled
+		DataModel::EventParameters *eventParameters() const { return _ep.get(); }
+		//! Registers all public objects of the result, must be called from
+		//! the GUI thread after the thread has finished
+		void registerObjects();
+		const QString &errorString() const { return _errorString; }
+
+	protected:
+		void run() override;
+
+	private:
+		std::string                    _file;
+		bool                           _discardDetails;
+		bool                           _useCache;
+		std::atomic<bool>              _canceled{false};
+		DataModel::EventParametersPtr  _ep;
+		QString                        _errorString;
+};
+
+
+}
+}
+
+
+#endif
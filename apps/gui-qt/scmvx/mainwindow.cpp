@@ -22,25 +22,33 @@
 
 #include <seiscomp/logging/log.h>
 #include <seiscomp/core/datamessage.h>
+#include <seiscomp/datamodel/databasequery.h>
 #include <seiscomp/gui/core/application.h>
 #include <seiscomp/gui/core/utils.h>
 #include <seiscomp/gui/datamodel/eventlayer.h>
 #include <seiscomp/gui/datamodel/origindialog.h>
 #include <seiscomp/io/archive/xmlarchive.h>
 
+#include <QComboBox>
 #include <QFileDialog>
+#include <QLabel>
 #include <QMessageBox>
+#include <QProgressDialog>
+#include <QSlider>
+#include <QToolBar>
 #include <QTreeWidget>
 
 #include "mainwindow.h"
 #include "searchwidget.h"
 #include "eventinfodialog.h"
+#include "eventparametersreader.h"
 #include "stationinfodialog.h"
 #include "map/networklayer.h"
 #include "map/eventlayer.h"
 #include "map/eventheatlayer.h"
 #include "map/currenteventlayer.h"
 #include "map/scalelayer.h"
+#include "map/stationlabellayer.h"
 
 
 using namespace std;
@@ -57,6 +65,26 @@ namespace MapViewX {
 
 
 
+namespace {
+
+
+// The resolution of the heat map playback slider
+const int PlaybackSliderSteps = 1000;
+
+// The number of events passed to the views per event loop iteration while
+// loading a file
+const size_t EventLoadChunkSize = 2000;
+
+// The minimum number of objects kept in the object cache
+const int MinimumCacheSize = 100;
+
+
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void MainWindow::Event::setEvent(DataModel::Event *evt, ObjectCache &cache) {
 	event = evt;
@@ -123,7 +151,7 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags f)
 	_ui.actionCenterMapOnEventUpdate->setChecked(global.centerOrigins);
 
 	_cache.setDatabaseArchive(SCApp->query());
-	_cache.setBufferSize(100);
+	_cache.setBufferSize(MinimumCacheSize);
 
 	connect(SCApp, SIGNAL(messageAvailable(Seiscomp::Core::Message*,Seiscomp::Client::Packet*)),
 	        this, SLOT(handleMessage(Seiscomp::Core::Message*)));
@@ -180,8 +208,40 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags f)
 	connect(_eventListView, SIGNAL(eventRemovedFromList(Seiscomp::DataModel::Event*)),
 	        _eventHeatLayer, SLOT(removeEvent(Seiscomp::DataModel::Event*)));
 
+	_playbackBar = new QToolBar(tr("Heatmap playback"), this);
+	_playbackBar->setObjectName("heatMapPlayback");
+	_playbackAction = _playbackBar->addAction(tr("Play"));
+	_playbackAction->setCheckable(true);
+
+	_playbackWindow = new QComboBox(_playbackBar);
+	_playbackWindow->addItem(tr("1 day"), 86400);
+	_playbackWindow->addItem(tr("1 week"), 7 * 86400);
+	_playbackWindow->addItem(tr("30 days"), 30 * 86400);
+	_playbackWindow->addItem(tr("90 days"), 90 * 86400);
+	_playbackWindow->setCurrentIndex(2);
+	_playbackBar->addWidget(_playbackWindow);
+
+	_playbackSlider = new QSlider(Qt::Horizontal, _playbackBar);
+	_playbackSlider->setRange(0, PlaybackSliderSteps);
+	_playbackBar->addWidget(_playbackSlider);
+
+	_playbackLabel = new QLabel(_playbackBar);
+	_playbackBar->addWidget(_playbackLabel);
+
+	addToolBar(Qt::BottomToolBarArea, _playbackBar);
+	_playbackBar->hide();
+
+	connect(_ui.actionHeatMapPlayback, SIGNAL(toggled(bool)), this, SLOT(toggleHeatMapPlayback(bool)));
+	connect(_playbackAction, SIGNAL(toggled(bool)), this, SLOT(toggleHeatMapPlaying(bool)));
+	connect(_playbackWindow, SIGNAL(currentIndexChanged(int)), this, SLOT(setHeatMapPlaybackWindow(int)));
+	connect(_playbackSlider, SIGNAL(valueChanged(int)), this, SLOT(seekHeatMapPlayback(int)));
+	connect(_eventHeatLayer, SIGNAL(playbackTimeChanged(Seiscomp::Core::Time)),
+	        this, SLOT(heatMapPlaybackTimeChanged(Seiscomp::Core::Time)));
+	connect(_eventHeatLayer, SIGNAL(playbackFinished()), this, SLOT(heatMapPlaybackFinished()));
+
 	_eventLayer = new EventLayer(_mapWidget, &_cache);
 	_eventLayer->setVisible(true);
+	_eventLayer->setThinningScale(global.eventThinningScale);
 
 	if ( global.eventLegendPosition == "topleft" ) {
 		_eventLayer->legend(0)->setArea(Qt::AlignLeft | Qt::AlignTop);
@@ -212,13 +272,12 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags f)
 	connect(_eventListView, SIGNAL(visibleEventCountChanged()),
 	        this, SLOT(updateEventTabText()));
 
-	_annotationLayer = new Gui::Map::AnnotationLayer(_mapWidget, new Gui::Map::Annotations);
-
 	_ui.actionShowStationAnnotations->setChecked(global.annotations);
 
-	_annotationLayer->setVisible(_ui.actionShowStationAnnotations->isChecked());
-
 	_stationLayer = new NetworkLayer(_mapWidget);
+	_annotationLayer = new StationLabelLayer(_stationLayer, _mapWidget);
+
+	_annotationLayer->setVisible(_ui.actionShowStationAnnotations->isChecked());
 
 	if ( global.stationLegendPosition == "topleft" ) {
 		_stationLayer->mainLegend()->setArea(Qt::AlignLeft | Qt::AlignTop);
@@ -235,11 +294,16 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags f)
 
 	_ui.actionShowChannelCodes->setChecked(global.annotationsWithChannels);
 	_ui.actionShowUnboundStations->setChecked(global.showUnboundStations);
+	_ui.actionClusterStations->setChecked(global.stationClustering);
 
-	_stationLayer->setInventory(Client::Inventory::Instance()->inventory(), _annotationLayer->annotations());
+	_stationLayer->setInventory(Client::Inventory::Instance()->inventory());
 	_stationLayer->setShowChannelCodes(_ui.actionShowChannelCodes->isChecked());
+	_stationLayer->setShowAnnotations(_ui.actionShowStationAnnotations->isChecked());
 	_stationLayer->setShowIssues(_ui.actionShowStationIssues->isChecked());
 	_stationLayer->setShowUnbound(_ui.actionShowUnboundStations->isChecked());
+	_stationLayer->setClusterDistance(global.stationClusterDistance);
+	_stationLayer->setTiledRendering(global.tiledStationRendering);
+	_stationLayer->setClusteringEnabled(_ui.actionClusterStations->isChecked());
 
 	connect(_stationLayer, SIGNAL(stationEntered(Seiscomp::DataModel::Station*)),
 	        this, SLOT(stationEntered(Seiscomp::DataModel::Station*)));
@@ -248,11 +312,13 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags f)
 	        this, SLOT(stationClicked(Seiscomp::DataModel::Station*)));
 
 	connect(_ui.actionShowStationAnnotations, SIGNAL(toggled(bool)), _annotationLayer, SLOT(setVisible(bool)));
+	connect(_ui.actionShowStationAnnotations, SIGNAL(toggled(bool)), _stationLayer, SLOT(setShowAnnotations(bool)));
 	connect(_ui.actionShowStationAnnotations, SIGNAL(toggled(bool)), _mapWidget, SLOT(update()));
 	connect(_ui.actionShowChannelCodes, SIGNAL(toggled(bool)), _stationLayer, SLOT(setShowChannelCodes(bool)));
 	connect(_ui.actionShowChannelCodes, SIGNAL(toggled(bool)), _mapWidget, SLOT(update()));
 	connect(_ui.actionShowStationIssues, SIGNAL(toggled(bool)), _stationLayer, SLOT(setShowIssues(bool)));
 	connect(_ui.actionShowUnboundStations, SIGNAL(toggled(bool)), _stationLayer, SLOT(setShowUnbound(bool)));
+	connect(_ui.actionClusterStations, SIGNAL(toggled(bool)), _stationLayer, SLOT(setClusteringEnabled(bool)));
 	connect(_ui.actionSearchStation, SIGNAL(triggered()), this, SLOT(searchStation()));
 	connect(_ui.actionCenterMapOnEventUpdate, SIGNAL(toggled(bool)), this, SLOT(toggleCentering(bool)));
 	connect(_ui.actionResetView, SIGNAL(triggered()), this, SLOT(resetView()));
@@ -316,6 +382,31 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags f)
 
 	connect(_ui.menuQC, SIGNAL(triggered(QAction*)), this, SLOT(applyQCMode(QAction*)));
 
+	{
+		QActionGroup *weightingActions = new QActionGroup(_ui.menuHeatMapWeighting);
+		QAction *action;
+
+		action = _ui.menuHeatMapWeighting->addAction(tr("Event count"));
+		action->setData(EventHeatLayer::Count);
+		action->setCheckable(true);
+		action->setActionGroup(weightingActions);
+		action->setChecked(_eventHeatLayer->weighting() == EventHeatLayer::Count);
+
+		action = _ui.menuHeatMapWeighting->addAction(tr("Magnitude"));
+		action->setData(EventHeatLayer::Magnitude);
+		action->setCheckable(true);
+		action->setActionGroup(weightingActions);
+		action->setChecked(_eventHeatLayer->weighting() == EventHeatLayer::Magnitude);
+
+		action = _ui.menuHeatMapWeighting->addAction(tr("Seismic energy"));
+		action->setData(EventHeatLayer::Energy);
+		action->setCheckable(true);
+		action->setActionGroup(weightingActions);
+		action->setChecked(_eventHeatLayer->weighting() == EventHeatLayer::Energy);
+	}
+
+	connect(_ui.menuHeatMapWeighting, SIGNAL(triggered(QAction*)), this, SLOT(applyHeatMapWeighting(QAction*)));
+
 	_mapWidget->canvas().addLayer(_eventHeatLayer);
 	_mapWidget->canvas().addLayer(_stationLayer);
 	_mapWidget->canvas().addLayer(_eventLayer);
@@ -356,6 +447,7 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags f)
 		readEventParameters(global.inputFile);
 	}
 	else {
+		prefetchEvents(tw);
 		_eventListView->readFromDatabase();
 	}
 	updateEventTabText();
@@ -371,6 +463,19 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags f)
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+MainWindow::~MainWindow() {
+	// Do not block on a running parser when the application is closed
+	if ( _eventReader ) {
+		_eventReader->discard();
+		_eventReader = nullptr;
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void MainWindow::toggleFullScreen() {
 	if ( _mapWidget->isFullScreen() )
@@ -550,6 +655,7 @@ void MainWindow::addObject(const QString &, DataModel::Object *obj) {
 		if ( !it->second->triggerTime ||
 		     (pick->time().value() > *it->second->triggerTime) ) {
 			it->second->triggerTime = pick->time().value();
+			_stationLayer->updateTrigger(it->second.get());
 		}
 
 		return;
@@ -806,38 +912,207 @@ void MainWindow::stationClicked(DataModel::Station *station) {
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-void MainWindow::readEventParameters(const std::string &file) {
-	QApplication::setOverrideCursor(Qt::WaitCursor);
+void MainWindow::prefetchEvents(const Core::TimeWindow &tw) {
+	DataModel::DatabaseQuery *query = SCApp->query();
+	if ( !query ) {
+		return;
+	}
 
-	IO::XMLArchive ar;
-	if ( !ar.open(file.c_str()) ) {
-		QApplication::restoreOverrideCursor();
-		QMessageBox::critical(this, tr("Read EventParameters"),
-			QString("Could not open file\n%1").arg(file.c_str())
-		);
+	std::vector<DataModel::PublicObjectPtr> objects;
+
+	// The preferred origins and magnitudes of all events in the time
+	// window, one query each
+	DataModel::DatabaseIterator it = query->getPreferredOrigins(tw.startTime(), tw.endTime(), "");
+	for ( ; *it; ++it ) {
+		DataModel::PublicObject *po = DataModel::PublicObject::Cast(*it);
+		if ( po ) {
+			objects.push_back(po);
+		}
+	}
+	it.close();
+
+	size_t origins = objects.size();
+
+	// -99 does not restrict the magnitude
+	it = query->getPreferredMagnitudes(tw.startTime(), tw.endTime(), -99, "");
+	for ( ; *it; ++it ) {
+		DataModel::PublicObject *po = DataModel::PublicObject::Cast(*it);
+		if ( po ) {
+			objects.push_back(po);
+		}
+	}
+	it.close();
+
+	// Keep the prefetched objects and the events and focal mechanisms
+	// resolved later on
+	int size = static_cast<int>(objects.size() + origins);
+	_cache.setBufferSize(std::max(MinimumCacheSize, size + size / 4));
+
+	for ( auto &po : objects ) {
+		_cache.feed(po.get());
+	}
+
+	SEISCOMP_DEBUG("Prefetched %d origins and %d magnitudes",
+	               static_cast<int>(origins),
+	               static_cast<int>(objects.size() - origins));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::readEventParameters(const std::string &file) {
+	if ( _eventReader || _eventLoadProgress ) {
+		SEISCOMP_WARNING("Still reading events, ignoring %s", file.c_str());
 		return;
 	}
 
+	// Release the current catalog first. Its public IDs stay registered
+	// as long as it is alive, and objects of the new catalog with the
+	// same IDs could not be registered.
 	_eventListView->clear();
 	_localEP = nullptr;
-	ar >> _localEP;
 
-	if ( !_localEP ) {
-		QApplication::restoreOverrideCursor();
-		QMessageBox::critical(this, tr("Read EventParameters"),
-			QString("Invalid file\n%1").arg(file.c_str())
-		);
+	// The reader is not owned by the window, a canceled reader keeps
+	// running until the parser returns and then deletes itself
+	_eventReader = new EventParametersReader(file, global.discardEventDetails,
+	                                         global.inputFileCache);
+	connect(_eventReader, SIGNAL(finished()), this, SLOT(eventParametersRead()));
+
+	// The range is unknown while parsing, show a busy indicator
+	_eventLoadProgress = new QProgressDialog(
+		tr("Reading %1 ...").arg(file.c_str()), tr("Cancel"), 0, 0, this
+	);
+	_eventLoadProgress->setWindowTitle(tr("Read EventParameters"));
+	_eventLoadProgress->setWindowModality(Qt::WindowModal);
+	_eventLoadProgress->setMinimumDuration(500);
+	connect(_eventLoadProgress, SIGNAL(canceled()),
+	        this, SLOT(cancelEventParametersReading()));
+
+	_eventReader->start();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::eventParametersRead() {
+	// Ignore a discarded reader whose notification was already queued
+	EventParametersReader *reader = _eventReader;
+	if ( !reader || (sender() != reader) ) {
 		return;
 	}
 
-	for ( size_t i = 0; i < _localEP->eventCount(); ++i ) {
+	_eventReader = nullptr;
+	reader->deleteLater();
+
+	if ( !reader->eventParameters() ) {
+		closeEventLoadProgress();
+		QMessageBox::critical(this, tr("Read EventParameters"), reader->errorString());
+		return;
+	}
+
+	reader->registerObjects();
+	_localEP = reader->eventParameters();
+	_loadedEvents = 0;
+
+	_eventLoadProgress->setLabelText(tr("Loading events ..."));
+	_eventLoadProgress->setRange(0, static_cast<int>(_localEP->eventCount()));
+	_eventLoadProgress->setValue(0);
+
+	loadEventChunk();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::loadEventChunk() {
+	// Loading has been canceled
+	if ( !_eventLoadProgress || !_localEP ) {
+		return;
+	}
+
+	size_t count = _localEP->eventCount();
+	size_t end = std::min(count, _loadedEvents + EventLoadChunkSize);
+	std::vector<DataModel::Event*> events;
+	events.reserve(end - _loadedEvents);
+
+	// Suppress the notifications of the list for each single event and
+	// pass all events of the chunk to the map layers at once
+	_eventListView->blockSignals(true);
+	for ( size_t i = _loadedEvents; i < end; ++i ) {
 		_eventListView->add(_localEP->event(i), nullptr);
+		events.push_back(_localEP->event(i));
+	}
+	_eventListView->blockSignals(false);
+
+	_eventLayer->addEvents(events);
+	_eventHeatLayer->addEvents(events);
+
+	_loadedEvents = end;
+
+	if ( _loadedEvents < count ) {
+		_eventLoadProgress->setValue(static_cast<int>(_loadedEvents));
+		QTimer::singleShot(0, this, SLOT(loadEventChunk()));
+		return;
 	}
 
+	finishEventLoading();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::cancelEventParametersReading() {
+	if ( _eventReader ) {
+		// The parser cannot be interrupted. Detach the reader so that
+		// another file can be opened right away.
+		_eventReader->discard();
+		_eventReader = nullptr;
+		closeEventLoadProgress();
+		return;
+	}
+
+	// Keep the events loaded so far
+	finishEventLoading();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::closeEventLoadProgress() {
+	if ( !_eventLoadProgress ) {
+		return;
+	}
+
+	// Closing the dialog emits canceled()
+	QProgressDialog *progress = _eventLoadProgress;
+	_eventLoadProgress = nullptr;
+	progress->disconnect(this);
+	progress->close();
+	progress->deleteLater();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::finishEventLoading() {
+	closeEventLoadProgress();
+	eventsUpdated();
+	updateEventTabText();
+
 	cerr << "= Total read events from file =" << endl;
 	cerr << " * Number of events: " << _eventLayer->eventCount() << endl;
-
-	QApplication::restoreOverrideCursor();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -1022,6 +1297,15 @@ void MainWindow::applyQCMode(QAction *action) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::applyHeatMapWeighting(QAction *action) {
+	_eventHeatLayer->setWeighting(static_cast<EventHeatLayer::Weighting>(action->data().toInt()));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void MainWindow::searchStation() {
 	if ( !_currentSearch ) {
@@ -1086,6 +1370,89 @@ void MainWindow::toggleCentering(bool enable) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::toggleHeatMapPlayback(bool enable) {
+	if ( enable ) {
+		_eventHeatLayer->setPlaybackWindow(Core::TimeSpan(_playbackWindow->currentData().toInt(), 0));
+		_eventHeatLayer->setVisible(true);
+	}
+	else {
+		_playbackAction->setChecked(false);
+	}
+
+	_eventHeatLayer->setPlaybackEnabled(enable);
+	_playbackBar->setVisible(enable);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::toggleHeatMapPlaying(bool play) {
+	if ( play ) {
+		_eventHeatLayer->play();
+	}
+	else {
+		_eventHeatLayer->pause();
+	}
+
+	_playbackAction->setText(_eventHeatLayer->isPlaying() ? tr("Pause") : tr("Play"));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::setHeatMapPlaybackWindow(int index) {
+	_eventHeatLayer->setPlaybackWindow(Core::TimeSpan(_playbackWindow->itemData(index).toInt(), 0));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::seekHeatMapPlayback(int position) {
+	Core::TimeWindow range = _eventHeatLayer->playbackRange();
+	double offset = static_cast<double>(range.length()) * position / PlaybackSliderSteps;
+	_eventHeatLayer->setPlaybackTime(range.startTime() + Core::TimeSpan(offset));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::heatMapPlaybackTimeChanged(const Core::Time &end) {
+	Core::TimeWindow range = _eventHeatLayer->playbackRange();
+	double length = static_cast<double>(range.length());
+
+	if ( length > 0 ) {
+		// Do not seek again while following the playback
+		QSignalBlocker blocker(_playbackSlider);
+		_playbackSlider->setValue(static_cast<int>(static_cast<double>(end - range.startTime()) / length * PlaybackSliderSteps));
+	}
+
+	_playbackLabel->setText(QString("%1 - %2")
+	                        .arg(Gui::timeToString(end - _eventHeatLayer->playbackWindow(), "%F %T"))
+	                        .arg(Gui::timeToString(end, "%F %T")));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void MainWindow::heatMapPlaybackFinished() {
+	_playbackAction->setChecked(false);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 }
 }
@@ -30,7 +30,6 @@
 #include <seiscomp/gui/core/mainwindow.h>
 #include <seiscomp/gui/datamodel/eventlistview.h>
 #include <seiscomp/gui/map/mapwidget.h>
-#include <seiscomp/gui/map/layers/annotationlayer.h>
 #endif
 
 #include <QTimer>
@@ -39,16 +38,25 @@
 #include "settings.h"
 
 
+class QComboBox;
+class QLabel;
+class QProgressDialog;
+class QSlider;
+class QToolBar;
+
+
 namespace Seiscomp {
 namespace MapViewX {
 
 
 class NetworkLayer;
+class StationLabelLayer;
 class EventLayer;
 class EventHeatLayer;
 class CurrentEventLayer;
 class SearchWidget;
 class EventInfoDialog;
+class EventParametersReader;
 
 
 class MainWindow : public Gui::MainWindow {
@@ -56,9 +64,15 @@ class MainWindow : public Gui::MainWindow {
 
 	public:
 		MainWindow(QWidget *parent = 0, Qt::WindowFlags = Qt::WindowFlags());
+		~MainWindow() override;
 
 
 	public:
+		/**
+		 * @brief Reads events from an XML file in the background. The
+		 *        events are passed to the event list and the map in
+		 *        chunks after the file has been parsed.
+		 */
 		void readEventParameters(const std::string &file);
 		void updateQC(Settings::StationData *data,
 		              DataModel::WaveformQuality *wfq);
@@ -106,17 +120,38 @@ class MainWindow : public Gui::MainWindow {
 		void updateEventTabText();
 
 		void applyQCMode(QAction*);
+		void applyHeatMapWeighting(QAction*);
 		void searchStation();
 		void filterStations();
 		void toggleCentering(bool);
 
+		void toggleHeatMapPlayback(bool);
+		void toggleHeatMapPlaying(bool);
+		void setHeatMapPlaybackWindow(int index);
+		void seekHeatMapPlayback(int position);
+		void heatMapPlaybackTimeChanged(const Seiscomp::Core::Time &end);
+		void heatMapPlaybackFinished();
+
 		void objectDestroyed(QObject*);
 
+		void eventParametersRead();
+		void loadEventChunk();
+		void cancelEventParametersReading();
+
 
 	private:
 		void updateCurrentEvent();
 		void showMapCoordinates(const QPoint &pos);
 		void sendArtificialOrigin(const QPoint &pos);
+		void finishEventLoading();
+		void closeEventLoadProgress();
+
+		/**
+		 * @brief Loads the preferred origins and magnitudes of all events
+		 *        in the time window with bulk queries into the object
+		 *        cache and grows the cache accordingly.
+		 */
+		void prefetchEvents(const Core::TimeWindow &tw);
 
 
 	private:
@@ -145,7 +180,7 @@ class MainWindow : public Gui::MainWindow {
 		Gui::MapWidget                *_mapWidget;
 		Gui::EventListView            *_eventListView;
 		NetworkLayer                  *_stationLayer;
-		Gui::Map::AnnotationLayer     *_annotationLayer;
+		StationLabelLayer             *_annotationLayer;
 		EventLayer                    *_eventLayer;
 		EventHeatLayer                *_eventHeatLayer;
 		CurrentEventLayer             *_currentEventLayer;
@@ -158,6 +193,15 @@ class MainWindow : public Gui::MainWindow {
 		EventInfoDialog               *_eventDetails{nullptr};
 		QByteArray                     _eventDetailsState;
 		DataModel::EventParametersPtr  _localEP;
+		EventParametersReader         *_eventReader{nullptr};
+		QProgressDialog               *_eventLoadProgress{nullptr};
+		//! The number of events of _localEP passed to the views so far
+		size_t                         _loadedEvents{0};
+		QToolBar                      *_playbackBar{nullptr};
+		QAction                       *_playbackAction{nullptr};
+		QComboBox                     *_playbackWindow{nullptr};
+		QSlider                       *_playbackSlider{nullptr};
+		QLabel                        *_playbackLabel{nullptr};
 };
 
 
@@ -0,0 +1,401 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+
+#include <seiscomp/gui/map/canvas.h>
+#include <seiscomp/gui/map/projection.h>
+#include <seiscomp/gui/map/projections/mercator.h>
+#include <seiscomp/gui/map/projections/rectangular.h>
+
+#include <QtMath>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "batchprojection.h"
+
+
+namespace Seiscomp::MapViewX {
+
+
+namespace {
+
+
+// Keeps screen coordinates of far away points in the range of int
+const double MaxScreenCoordinate = 1E7;
+// The Mercator transformation diverges at the poles
+const double MaxMercatorLatitude = 89.9;
+// Within this latitude range the Mercator transformation is interpolated
+// from a table, beyond it is computed exactly
+const double MercatorTableLimit = 85.0;
+const double MercatorTableStep = 0.1;
+const int MercatorTableSize = static_cast<int>(2 * MercatorTableLimit / MercatorTableStep) + 1;
+
+
+inline double wrapLongitude(double lon) {
+	while ( lon >= 180.0 ) lon -= 360.0;
+	while ( lon < -180.0 ) lon += 360.0;
+	return lon;
+}
+
+
+inline int toScreen(double v) {
+	return static_cast<int>(std::nearbyint(qBound(-MaxScreenCoordinate, v, MaxScreenCoordinate)));
+}
+
+
+//! Returns the Mercator transformed latitude in degrees
+inline double mercatorLatitude(double latitude) {
+	return qRadiansToDegrees(std::log(std::tan(M_PI_4 + qDegreesToRadians(latitude) * 0.5)));
+}
+
+
+/**
+ * @brief Samples of the Mercator transformation and its derivative for
+ *        cubic Hermite interpolation. Within the table range the error is
+ *        below 1E-6 degrees.
+ */
+struct MercatorTable {
+	MercatorTable() {
+		for ( int i = 0; i < MercatorTableSize; ++i ) {
+			double latitude = -MercatorTableLimit + i * MercatorTableStep;
+			values[i] = mercatorLatitude(latitude);
+			// The derivative is sec(latitude), scaled to one table step
+			slopes[i] = MercatorTableStep / std::cos(qDegreesToRadians(latitude));
+		}
+	}
+
+	double values[MercatorTableSize];
+	double slopes[MercatorTableSize];
+};
+
+
+const MercatorTable &mercatorTable() {
+	static const MercatorTable table;
+	return table;
+}
+
+
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+BatchProjection::BatchProjection(const Gui::Map::Canvas *canvas)
+: _projection(canvas->projection()) {
+	Type type = Generic;
+
+	// Mercator derives from the rectangular projection and must be
+	// checked first
+	if ( dynamic_cast<const Gui::Map::MercatorProjection*>(_projection) ) {
+		type = Mercator;
+	}
+	else if ( dynamic_cast<const Gui::Map::RectangularProjection*>(_projection) ) {
+		type = Rectangular;
+	}
+
+	if ( type != Generic && !setup(canvas, type) ) {
+		_type = Generic;
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool BatchProjection::setup(const Gui::Map::Canvas *canvas, Type type) {
+	_type = type;
+	_width = canvas->width();
+	_height = canvas->height();
+	_scale = canvas->pixelPerDegree();
+
+	if ( _width <= 0 || _height <= 0 || _scale <= 0 ) {
+		return false;
+	}
+
+	QPointF center;
+	QPoint pos;
+
+	if ( !_projection->unproject(center, QPoint(_width / 2, _height / 2)) ) {
+		return false;
+	}
+
+	if ( !_projection->project(pos, center) ) {
+		return false;
+	}
+
+	_centerLongitude = center.x();
+	_xOffset = pos.x();
+	_yOffset = pos.y() + _scale * transformLatitude(center.y());
+
+	return validate();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool BatchProjection::validate() {
+	static const double LongitudeOffsets[] = {
+		-179.5, -135, -90, -45, -10, -1, 0, 1, 10, 45, 90, 135, 179.5
+	};
+	static const double Latitudes[] = {
+		-85, -60, -30, -5, 0, 5, 30, 60, 85
+	};
+
+	struct Probe {
+		double latitude;
+		double longitude;
+		QPoint reference;
+		bool   referenceClipped;
+		int    x;
+		int    y;
+	};
+
+	Probe probes[sizeof(LongitudeOffsets) / sizeof(double) * sizeof(Latitudes) / sizeof(double)];
+	int count = 0;
+
+	_clipToCanvas = false;
+
+	for ( double offset : LongitudeOffsets ) {
+		for ( double lat : Latitudes ) {
+			Probe &probe = probes[count++];
+			probe.latitude = lat;
+			probe.longitude = wrapLongitude(_centerLongitude + offset);
+			probe.referenceClipped = !_projection->project(probe.reference, QPointF(probe.longitude, probe.latitude));
+			projectLinear(&probe.x, &probe.y, &probe.latitude, &probe.longitude, 1);
+
+			// The projection reports points outside the canvas as clipped
+			if ( probe.referenceClipped ) {
+				_clipToCanvas = true;
+			}
+		}
+	}
+
+	for ( int i = 0; i < count; ++i ) {
+		const Probe &probe = probes[i];
+
+		if ( isClipped(probe.x, probe.y) != probe.referenceClipped ) {
+			// Tolerate rounding differences at the canvas border
+			bool nearBorder = _clipToCanvas &&
+			                  probe.x >= -1 && probe.x <= _width &&
+			                  probe.y >= -1 && probe.y <= _height &&
+			                  (probe.x < 1 || probe.x >= _width - 1 ||
+			                   probe.y < 1 || probe.y >= _height - 1);
+			if ( !nearBorder ) {
+				return false;
+			}
+
+			continue;
+		}
+
+		if ( probe.referenceClipped ) {
+			continue;
+		}
+
+		if ( std::abs(probe.reference.x() - probe.x) > 1 ||
+		     std::abs(probe.reference.y() - probe.y) > 1 ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void BatchProjection::project(int *x, int *y, quint8 *flags, quint8 clippedFlag,
+                              const double *latitude, const double *longitude,
+                              int count) const {
+	if ( _type == Generic ) {
+		projectGeneric(x, y, flags, clippedFlag, latitude, longitude, count);
+		return;
+	}
+
+	projectLinear(x, y, latitude, longitude, count);
+
+	for ( int i = 0; i < count; ++i ) {
+		if ( isClipped(x[i], y[i]) ) {
+			flags[i] |= clippedFlag;
+		}
+		else {
+			flags[i] &= ~clippedFlag;
+		}
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void BatchProjection::projectGeneric(int *x, int *y, quint8 *flags,
+                                     quint8 clippedFlag,
+                                     const double *latitude,
+                                     const double *longitude,
+                                     int count) const {
+	QPoint pos;
+
+	for ( int i = 0; i < count; ++i ) {
+		if ( _projection->project(pos, QPointF(longitude[i], latitude[i])) ) {
+			flags[i] &= ~clippedFlag;
+		}
+		else {
+			flags[i] |= clippedFlag;
+		}
+
+		x[i] = pos.x();
+		y[i] = pos.y();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void BatchProjection::projectLinear(int *x, int *y,
+                                    const double *latitude,
+                                    const double *longitude,
+                                    int count) const {
+	int i = 0;
+
+#if defined(__SSE2__)
+	const __m128d scale = _mm_set1_pd(_scale);
+	const __m128d centerLongitude = _mm_set1_pd(_centerLongitude);
+	const __m128d xOffset = _mm_set1_pd(_xOffset);
+	const __m128d yOffset = _mm_set1_pd(_yOffset);
+	const __m128d halfTurn = _mm_set1_pd(180.0);
+	const __m128d negHalfTurn = _mm_set1_pd(-180.0);
+	const __m128d fullTurn = _mm_set1_pd(360.0);
+	const __m128d lowerBound = _mm_set1_pd(-MaxScreenCoordinate);
+	const __m128d upperBound = _mm_set1_pd(MaxScreenCoordinate);
+	const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+	const __m128d tableLimit = _mm_set1_pd(MercatorTableLimit);
+	const __m128d tableScale = _mm_set1_pd(1.0 / MercatorTableStep);
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d two = _mm_set1_pd(2.0);
+	const __m128d three = _mm_set1_pd(3.0);
+	const MercatorTable &table = mercatorTable();
+
+	for ( ; i + 2 <= count; i += 2 ) {
+		// Longitude difference to the center wrapped to [-180,180), input
+		// longitudes are expected to be within [-180,180]
+		__m128d lon = _mm_sub_pd(_mm_loadu_pd(longitude + i), centerLongitude);
+		for ( int k = 0; k < 2; ++k ) {
+			lon = _mm_sub_pd(lon, _mm_and_pd(_mm_cmpge_pd(lon, halfTurn), fullTurn));
+			lon = _mm_add_pd(lon, _mm_and_pd(_mm_cmplt_pd(lon, negHalfTurn), fullTurn));
+		}
+
+		__m128d lat = _mm_loadu_pd(latitude + i);
+		if ( _type == Mercator ) {
+			// Also true for NaN
+			__m128d outside = _mm_cmpnle_pd(_mm_and_pd(lat, absMask), tableLimit);
+
+			if ( _mm_movemask_pd(outside) ) {
+				lat = _mm_set_pd(transformLatitude(latitude[i + 1]),
+				                 transformLatitude(latitude[i]));
+			}
+			else {
+				// Cubic Hermite interpolation between two table entries
+				__m128d pos = _mm_mul_pd(_mm_add_pd(lat, tableLimit), tableScale);
+				int index[4];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(index), _mm_cvttpd_epi32(pos));
+				index[0] = std::min(index[0], MercatorTableSize - 2);
+				index[1] = std::min(index[1], MercatorTableSize - 2);
+
+				__m128d t = _mm_sub_pd(pos, _mm_set_pd(index[1], index[0]));
+				__m128d y0 = _mm_set_pd(table.values[index[1]], table.values[index[0]]);
+				__m128d y1 = _mm_set_pd(table.values[index[1] + 1], table.values[index[0] + 1]);
+				__m128d m0 = _mm_set_pd(table.slopes[index[1]], table.slopes[index[0]]);
+				__m128d m1 = _mm_set_pd(table.slopes[index[1] + 1], table.slopes[index[0] + 1]);
+
+				__m128d t2 = _mm_mul_pd(t, t);
+				__m128d t3 = _mm_mul_pd(t2, t);
+				// h01 = 3t^2 - 2t^3, h00 = 1 - h01
+				__m128d h01 = _mm_sub_pd(_mm_mul_pd(three, t2), _mm_mul_pd(two, t3));
+				__m128d h00 = _mm_sub_pd(one, h01);
+				// h11 = t^3 - t^2, h10 = h11 - t^2 + t
+				__m128d h11 = _mm_sub_pd(t3, t2);
+				__m128d h10 = _mm_add_pd(_mm_sub_pd(h11, t2), t);
+
+				lat = _mm_add_pd(_mm_add_pd(_mm_mul_pd(h00, y0), _mm_mul_pd(h10, m0)),
+				                 _mm_add_pd(_mm_mul_pd(h01, y1), _mm_mul_pd(h11, m1)));
+			}
+		}
+
+		__m128d fx = _mm_add_pd(xOffset, _mm_mul_pd(lon, scale));
+		__m128d fy = _mm_sub_pd(yOffset, _mm_mul_pd(lat, scale));
+
+		fx = _mm_min_pd(_mm_max_pd(fx, lowerBound), upperBound);
+		fy = _mm_min_pd(_mm_max_pd(fy, lowerBound), upperBound);
+
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(x + i), _mm_cvtpd_epi32(fx));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(y + i), _mm_cvtpd_epi32(fy));
+	}
+#endif
+
+	for ( ; i < count; ++i ) {
+		x[i] = toScreen(_xOffset + wrapLongitude(longitude[i] - _centerLongitude) * _scale);
+		y[i] = toScreen(_yOffset - transformLatitude(latitude[i]) * _scale);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+double BatchProjection::transformLatitude(double latitude) const {
+	if ( _type != Mercator ) {
+		return latitude;
+	}
+
+	return mercatorLatitude(qBound(-MaxMercatorLatitude, latitude, MaxMercatorLatitude));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool BatchProjection::isClipped(int x, int y) const {
+	return _clipToCanvas && (x < 0 || y < 0 || x >= _width || y >= _height);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
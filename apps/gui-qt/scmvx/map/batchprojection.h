@@ -0,0 +1,132 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+#ifndef SEISCOMP_MAPVIEWX_BATCHPROJECTION_H
+#define SEISCOMP_MAPVIEWX_BATCHPROJECTION_H
+
+
+#include <QtGlobal>
+
+
+namespace Seiscomp {
+
+namespace Gui::Map {
+
+class Canvas;
+class Projection;
+
+}
+
+namespace MapViewX {
+
+
+/**
+ * @brief Projects arrays of geographic coordinates to screen coordinates.
+ *
+ * For the rectangular and the Mercator projection the mapping is linear
+ * in longitude and in (transformed) latitude. The coefficients are derived
+ * once per view from the projection of the canvas and validated against a
+ * set of probe points. If the projection is not supported or the
+ * validation fails, the points are projected one by one through the
+ * projection of the canvas.
+ */
+class BatchProjection {
+	// ----------------------------------------------------------------------
+	//  Public types
+	// ----------------------------------------------------------------------
+	public:
+		enum Type {
+			Generic,
+			Rectangular,
+			Mercator
+		};
+
+
+	// ----------------------------------------------------------------------
+	//  X'truction
+	// ----------------------------------------------------------------------
+	public:
+		explicit BatchProjection(const Gui::Map::Canvas *canvas);
+
+
+	// ----------------------------------------------------------------------
+	//  Public interface
+	// ----------------------------------------------------------------------
+	public:
+		//! Returns the type of the projection path in use
+		Type type() const { return _type; }
+
+		/**
+		 * @brief Projects count points.
+		 * @param x The output screen x coordinates
+		 * @param y The output screen y coordinates
+		 * @param flags The output flags. The bit clippedFlag is set if a
+		 *              point is clipped and cleared otherwise, all other
+		 *              bits are left untouched.
+		 * @param clippedFlag The bit to update in flags
+		 * @param latitude The input latitudes in degrees
+		 * @param longitude The input longitudes in degrees
+		 * @param count The number of points
+		 */
+		void project(int *x, int *y, quint8 *flags, quint8 clippedFlag,
+		             const double *latitude, const double *longitude,
+		             int count) const;
+
+
+	// ----------------------------------------------------------------------
+	//  Private methods
+	// ----------------------------------------------------------------------
+	private:
+		bool setup(const Gui::Map::Canvas *canvas, Type type);
+		bool validate();
+
+		void projectGeneric(int *x, int *y, quint8 *flags, quint8 clippedFlag,
+		                    const double *latitude, const double *longitude,
+		                    int count) const;
+		void projectLinear(int *x, int *y,
+		                   const double *latitude, const double *longitude,
+		                   int count) const;
+
+		double transformLatitude(double latitude) const;
+		bool isClipped(int x, int y) const;
+
+
+	// ----------------------------------------------------------------------
+	//  Private members
+	// ----------------------------------------------------------------------
+	private:
+		const Gui::Map::Projection *_projection;
+		Type                        _type{Generic};
+		//! Whether points outside the canvas are reported as clipped
+		bool                        _clipToCanvas{false};
+		int                         _width{0};
+		int                         _height{0};
+		double                      _scale{0};
+		double                      _centerLongitude{0};
+		double                      _xOffset{0};
+		double                      _yOffset{0};
+};
+
+
+}
+}
+
+
+#endif
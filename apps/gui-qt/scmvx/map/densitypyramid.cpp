@@ -0,0 +1,328 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "densitypyramid.h"
+#include "parallel.h"
+
+
+namespace Seiscomp::MapViewX {
+
+
+namespace {
+
+
+// After a kernel has been removed, cells below this fraction of its weight
+// are reset to zero. This clears the rounding residue of the removal while
+// even the contribution of a M2 event in energy mode stays above the
+// threshold of a M9.5 event.
+const double RemovalTolerance = 1E-12;
+const int MinimumKernelRadius = 2;
+
+
+inline int wrapColumn(int column, int columns) {
+	column %= columns;
+	return column < 0 ? column + columns : column;
+}
+
+
+/**
+ * @brief Adds weight times the kernel weights to count cells. Cells below
+ *        tolerance are reset to zero.
+ */
+void accumulateRow(double *cells, const float *kernel, int count,
+                   double weight, double tolerance) {
+	int i = 0;
+
+#if defined(__SSE2__)
+	__m128d w = _mm_set1_pd(weight);
+	__m128d t = _mm_set1_pd(tolerance);
+
+	for ( ; i + 2 <= count; i += 2 ) {
+		__m128d v = _mm_loadu_pd(cells + i);
+		__m128d k = _mm_cvtps_pd(_mm_castsi128_ps(
+			_mm_loadl_epi64(reinterpret_cast<const __m128i*>(kernel + i))
+		));
+		__m128d r = _mm_add_pd(v, _mm_mul_pd(w, k));
+		r = _mm_and_pd(r, _mm_cmpge_pd(r, t));
+		_mm_storeu_pd(cells + i, r);
+	}
+#endif
+
+	for ( ; i < count; ++i ) {
+		double &v = cells[i];
+		v += weight * kernel[i];
+		if ( v < tolerance ) v = 0;
+	}
+}
+
+
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+DensityPyramid::DensityPyramid() {
+	for ( int l = 0; l < Levels; ++l ) {
+		Level &level = _levels[l];
+		level.columns = BaseColumns << l;
+		level.rows = level.columns / 2;
+		level.cellSize = 360.0 / level.columns;
+		level.kernelScale = kernelScale(1.0 / level.cellSize);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void DensityPyramid::clear() {
+	for ( auto &level : _levels ) {
+		std::fill(level.data.begin(), level.data.end(), 0.0);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void DensityPyramid::add(const QPointF &location, float magnitude, float weight) {
+	for ( auto &level : _levels ) {
+		// The grids are allocated with the first event
+		if ( level.data.empty() ) {
+			level.data.resize(level.columns * level.rows, 0.0);
+		}
+
+		splat(level, location, magnitude, weight);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void DensityPyramid::add(const Kernels &kernels) {
+	if ( kernels.empty() ) {
+		return;
+	}
+
+	// Create all required stamps up front, the levels only read the
+	// stamp cache while they are updated concurrently
+	for ( auto &level : _levels ) {
+		if ( level.data.empty() ) {
+			level.data.resize(level.columns * level.rows, 0.0);
+		}
+
+		for ( const auto &kernel : kernels ) {
+			stamp(kernelRadius(level, kernel.magnitude));
+		}
+	}
+
+	parallelFor(Levels, [this, &kernels](int l) {
+		for ( const auto &kernel : kernels ) {
+			splat(_levels[l], kernel.location, kernel.magnitude, kernel.weight);
+		}
+	});
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void DensityPyramid::remove(const QPointF &location, float magnitude, float weight) {
+	for ( auto &level : _levels ) {
+		if ( level.data.empty() ) {
+			continue;
+		}
+
+		splat(level, location, magnitude, -weight);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+int DensityPyramid::selectLevel(double pixelPerDegree) {
+	for ( int l = Levels - 1; l > 0; --l ) {
+		if ( 360.0 / (BaseColumns << l) * pixelPerDegree >= 1.0 ) {
+			return l;
+		}
+	}
+
+	return 0;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool DensityPyramid::isResolved(double pixelPerDegree) {
+	return 360.0 / (BaseColumns << (Levels - 1)) * pixelPerDegree < 2.0;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+float DensityPyramid::kernelScale(double unitsPerDegree) {
+	// The former screen space kernel size of 4*(1+log(pixelPerDegree))
+	// pixels per magnitude unit
+	return static_cast<float>(4*(1+log(std::max(1.0, unitsPerDegree))));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+float DensityPyramid::sample(const Level &level, double lon, double lat) {
+	if ( level.data.empty() ) {
+		return 0;
+	}
+
+	// Cell centers are located at integer positions
+	double fx = (lon + 180.0) / level.cellSize - 0.5;
+	double fy = (90.0 - lat) / level.cellSize - 0.5;
+
+	int x0 = static_cast<int>(floor(fx));
+	int y0 = static_cast<int>(floor(fy));
+	float tx = static_cast<float>(fx - x0);
+	float ty = static_cast<float>(fy - y0);
+
+	int x1 = wrapColumn(x0 + 1, level.columns);
+	x0 = wrapColumn(x0, level.columns);
+	int y1 = qBound(0, y0 + 1, level.rows - 1);
+	y0 = qBound(0, y0, level.rows - 1);
+
+	const double *row0 = level.data.data() + y0 * level.columns;
+	const double *row1 = level.data.data() + y1 * level.columns;
+
+	double top = row0[x0] + (row0[x1] - row0[x0]) * tx;
+	double bottom = row1[x0] + (row1[x1] - row1[x0]) * tx;
+
+	return static_cast<float>(top + (bottom - top) * ty);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const DensityPyramid::KernelStamp &DensityPyramid::stamp(int radius) {
+	auto it = _stamps.find(radius);
+	if ( it != _stamps.end() ) {
+		return it->second;
+	}
+
+	KernelStamp &kernel = _stamps[radius];
+	int radiusSquared = radius * radius;
+
+	for ( int ry = -radius; ry <= radius; ++ry ) {
+		int halfWidth = radius;
+		while ( halfWidth*halfWidth + ry*ry > radiusSquared ) {
+			--halfWidth;
+		}
+
+		kernel.halfWidths.push_back(halfWidth);
+		kernel.offsets.push_back(static_cast<int>(kernel.weights.size()));
+
+		for ( int rx = -halfWidth; rx <= halfWidth; ++rx ) {
+			int distanceSquared = rx*rx + ry*ry;
+			kernel.weights.push_back(1.0f - (float)distanceSquared / (float)radiusSquared);
+		}
+	}
+
+	return kernel;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+int DensityPyramid::kernelRadius(const Level &level, float magnitude) {
+	// Limit the radius to half of the globe, otherwise the kernel would
+	// overlap itself after wrapping around
+	int radius = std::max(MinimumKernelRadius,
+	                      static_cast<int>(magnitude * level.kernelScale));
+	return std::min(radius, level.columns / 2 - 1);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void DensityPyramid::splat(Level &level, const QPointF &location,
+                           float magnitude, float weight) {
+	int cx = static_cast<int>(floor((location.x() + 180.0) / level.cellSize));
+	int cy = static_cast<int>(floor((90.0 - location.y()) / level.cellSize));
+	cy = qBound(0, cy, level.rows - 1);
+
+	int radius = kernelRadius(level, magnitude);
+	const KernelStamp &kernel = stamp(radius);
+	// Additions cannot produce residue, cells stay non-negative
+	double tolerance = weight < 0 ? -weight * RemovalTolerance : 0.0;
+
+	for ( int ry = -radius; ry <= radius; ++ry ) {
+		int y = cy + ry;
+		if ( y < 0 || y >= level.rows ) continue;
+
+		int halfWidth = kernel.halfWidths[ry + radius];
+		const float *weights = kernel.weights.data() + kernel.offsets[ry + radius];
+		double *row = level.data.data() + y * level.columns;
+
+		int x0 = wrapColumn(cx - halfWidth, level.columns);
+		int count = 2 * halfWidth + 1;
+
+		// Rows crossing the antimeridian are split into two segments
+		int head = std::min(count, level.columns - x0);
+		accumulateRow(row + x0, weights, head, weight, tolerance);
+		if ( head < count ) {
+			accumulateRow(row, weights + head, count - head, weight, tolerance);
+		}
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -0,0 +1,173 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+#ifndef SEISCOMP_MAPVIEWX_DENSITYPYRAMID_H
+#define SEISCOMP_MAPVIEWX_DENSITYPYRAMID_H
+
+
+#include <QPointF>
+
+#include <unordered_map>
+#include <vector>
+
+
+namespace Seiscomp::MapViewX {
+
+
+/**
+ * @brief Multi-resolution geographic density grid of event kernels.
+ *
+ * Level 0 divides the globe into 128 x 64 cells, each following level
+ * doubles the resolution. Every event adds a radial kernel to each level
+ * whose radius in cells grows with the magnitude and with the resolution
+ * of the level, in the same way the kernel on screen grows with the
+ * zoom. Events are added and removed incrementally and the result is
+ * independent of the viewport: rendering resamples the level matching
+ * the current scale. Zoomed in beyond the finest level, see isResolved(),
+ * the kernels must be drawn in screen space instead.
+ *
+ * Kernels are precomputed per radius and added row by row.
+ */
+class DensityPyramid {
+	// ----------------------------------------------------------------------
+	//  Public types
+	// ----------------------------------------------------------------------
+	public:
+		static const int Levels = 5;
+		static const int BaseColumns = 128;
+
+		struct Level {
+			int                 columns{0};
+			int                 rows{0};
+			//! The size of a cell in degrees
+			double              cellSize{0};
+			//! The kernel radius in cells per magnitude unit
+			float               kernelScale{0};
+			//! The row-major cell values, row 0 is the northernmost row.
+			//! Accumulated in double precision, event weights span many
+			//! orders of magnitude.
+			std::vector<double> data;
+		};
+
+		struct Kernel {
+			//! The event location as (lon, lat)
+			QPointF  location;
+			float    magnitude;
+			float    weight;
+		};
+
+		using Kernels = std::vector<Kernel>;
+
+
+	// ----------------------------------------------------------------------
+	//  X'truction
+	// ----------------------------------------------------------------------
+	public:
+		DensityPyramid();
+
+
+	// ----------------------------------------------------------------------
+	//  Public interface
+	// ----------------------------------------------------------------------
+	public:
+		//! Resets all cells to zero
+		void clear();
+
+		/**
+		 * @brief Adds the kernel of an event to all levels.
+		 * @param location The event location as (lon, lat)
+		 * @param magnitude The event magnitude
+		 * @param weight The factor applied to the kernel
+		 */
+		void add(const QPointF &location, float magnitude, float weight = 1.0f);
+
+		/**
+		 * @brief Adds the kernels of many events at once. The levels are
+		 *        updated in parallel.
+		 */
+		void add(const Kernels &kernels);
+
+		//! Subtracts a kernel previously added with add
+		void remove(const QPointF &location, float magnitude, float weight = 1.0f);
+
+		/**
+		 * @brief Returns the finest level whose cells are not smaller
+		 *        than a pixel for the given scale.
+		 */
+		static int selectLevel(double pixelPerDegree);
+
+		/**
+		 * @brief Returns whether the finest level resolves the given
+		 *        scale, i.e. its cells are smaller than two pixels.
+		 */
+		static bool isResolved(double pixelPerDegree);
+
+		/**
+		 * @brief Returns the kernel radius per magnitude unit for a
+		 *        resolution. The same scale applies to the cells of a
+		 *        level and to screen pixels.
+		 * @param unitsPerDegree Cells or pixels per degree
+		 */
+		static float kernelScale(double unitsPerDegree);
+
+		const Level &level(int l) const { return _levels[l]; }
+
+		/**
+		 * @brief Samples a level with bilinear interpolation.
+		 * @param lon The longitude in degrees
+		 * @param lat The latitude in degrees
+		 */
+		static float sample(const Level &level, double lon, double lat);
+
+
+	// ----------------------------------------------------------------------
+	//  Private methods
+	// ----------------------------------------------------------------------
+	private:
+		struct KernelStamp {
+			//! The half width of each row starting with the top row
+			std::vector<int>    halfWidths;
+			//! The offset of each row into weights
+			std::vector<int>    offsets;
+			//! The weights of all rows inside the circle
+			std::vector<float>  weights;
+		};
+
+		const KernelStamp &stamp(int radius);
+
+		static int kernelRadius(const Level &level, float magnitude);
+
+		void splat(Level &level, const QPointF &location, float magnitude,
+		           float weight);
+
+
+	// ----------------------------------------------------------------------
+	//  Private members
+	// ----------------------------------------------------------------------
+	private:
+		Level                                 _levels[Levels];
+		std::unordered_map<int, KernelStamp>  _stamps;
+};
+
+
+}
+
+
+#endif
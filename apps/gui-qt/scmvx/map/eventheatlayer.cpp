@@ -24,19 +24,56 @@
 #include <seiscomp/datamodel/magnitude.h>
 #include <seiscomp/gui/core/compat.h>
 #include <seiscomp/gui/map/canvas.h>
+#include <seiscomp/gui/map/projection.h>
 
 #include <QApplication>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "batchprojection.h"
+#include "legendcache.h"
+#include "parallel.h"
+
 
 namespace Seiscomp::MapViewX {
 
 namespace {
 
 
+// Events without magnitude still contribute in magnitude mode
+const float MinimumMagnitudeWeight = 0.1f;
+// The magnitude with energy weight 1
+const float EnergyReferenceMagnitude = 5.0f;
+const float MaximumEnergyMagnitude = 9.5f;
+
+
+float eventWeight(float magnitude, EventHeatLayer::Weighting weighting) {
+	switch ( weighting ) {
+		case EventHeatLayer::Magnitude:
+			return qMax(MinimumMagnitudeWeight, magnitude);
+		case EventHeatLayer::Energy:
+			// log10(E) = 1.5 M + 4.8, relative to the reference magnitude
+			return pow(10.0f, 1.5f * (qMin(magnitude, MaximumEnergyMagnitude) - EnergyReferenceMagnitude));
+		default:
+			break;
+	}
+
+	return 1.0f;
+}
+
+
 void fillEvent(EventHeatLayer::Event *evt,
                DataModel::Event *event,
-               DataModel::Origin *org) {
+               DataModel::Origin *org,
+               EventHeatLayer::Weighting weighting) {
 	evt->location = QPointF(org->longitude(), org->latitude());
+	evt->time = org->time().value();
 
 	DataModel::Magnitude *mag = DataModel::Magnitude::Find(event->preferredMagnitudeID());
 	if ( mag ) {
@@ -49,6 +86,284 @@ void fillEvent(EventHeatLayer::Event *evt,
 	}
 	else
 		evt->magnitude = 0;
+
+	evt->weight = eventWeight(evt->magnitude, weighting);
+}
+
+
+// The number of screen rows resampled by one thread pool task
+const int HeatMapBandHeight = 64;
+
+// The playback frame interval in milliseconds
+const int PlaybackFrameInterval = 33;
+// The duration of a playback of the whole time range in seconds
+const double PlaybackDuration = 20.0;
+
+
+/**
+ * @brief Maps screen pixels to geographic coordinates.
+ *
+ * The screen is unprojected on a coarse grid of nodes and the coordinates
+ * are interpolated linearly in between. Blocks with corners off the map
+ * or with a large longitude span, e.g. around the poles, are unprojected
+ * pixel by pixel. unprojectRow may be called concurrently.
+ */
+class ScreenGeoGrid {
+	public:
+		static const int Step = 16;
+
+		ScreenGeoGrid(const Gui::Map::Projection *projection, int width, int height)
+		: _projection(projection), _width(width)
+		, _columns(width/Step+2), _rows(height/Step+2)
+		, _nodes(_columns*_rows) {
+			parallelFor(_rows, [this](int r) {
+				for ( int c = 0; c < _columns; ++c ) {
+					Node &node = _nodes[r*_columns+c];
+					node.valid = _projection->unproject(node.location, QPoint(c*Step, r*Step));
+				}
+			});
+		}
+
+		/**
+		 * @brief Unprojects all pixels of a screen row.
+		 * @param valid Set to 0 for pixels without a geographic location
+		 */
+		void unprojectRow(int y, double *lon, double *lat, quint8 *valid) const {
+			int r = y / Step;
+			double ty = double(y - r*Step) / Step;
+
+			for ( int c = 0, x0 = 0; x0 < _width; ++c, x0 += Step ) {
+				int x1 = qMin(x0 + Step, _width);
+				const Node &a = _nodes[r*_columns+c];
+				const Node &b = _nodes[r*_columns+c+1];
+				const Node &d = _nodes[(r+1)*_columns+c];
+				const Node &e = _nodes[(r+1)*_columns+c+1];
+
+				bool interpolate = a.valid && b.valid && d.valid && e.valid;
+				double lonA = 0, lonB = 0, lonD = 0, lonE = 0;
+
+				if ( interpolate ) {
+					lonA = a.location.x();
+					lonB = unwrap(b.location.x(), lonA);
+					lonD = unwrap(d.location.x(), lonA);
+					lonE = unwrap(e.location.x(), lonA);
+					interpolate = qMax(qMax(fabs(lonB-lonA), fabs(lonD-lonA)), fabs(lonE-lonA)) < MaxBlockSpan;
+				}
+
+				if ( interpolate ) {
+					double leftLon = lonA + (lonD-lonA)*ty;
+					double rightLon = lonB + (lonE-lonB)*ty;
+					double leftLat = a.location.y() + (d.location.y()-a.location.y())*ty;
+					double rightLat = b.location.y() + (e.location.y()-b.location.y())*ty;
+
+					for ( int x = x0; x < x1; ++x ) {
+						double tx = double(x - x0) / Step;
+						lon[x] = leftLon + (rightLon-leftLon)*tx;
+						lat[x] = leftLat + (rightLat-leftLat)*tx;
+						valid[x] = 1;
+					}
+				}
+				else {
+					QPointF location;
+					for ( int x = x0; x < x1; ++x ) {
+						valid[x] = _projection->unproject(location, QPoint(x, y)) ? 1 : 0;
+						lon[x] = location.x();
+						lat[x] = location.y();
+					}
+				}
+			}
+		}
+
+
+	private:
+		static constexpr double MaxBlockSpan = 45.0;
+
+		struct Node {
+			QPointF location;
+			bool    valid;
+		};
+
+		static double unwrap(double lon, double reference) {
+			while ( lon - reference > 180.0 ) lon -= 360.0;
+			while ( lon - reference < -180.0 ) lon += 360.0;
+			return lon;
+		}
+
+		const Gui::Map::Projection *_projection;
+		int                         _width;
+		int                         _columns;
+		int                         _rows;
+		std::vector<Node>           _nodes;
+};
+
+
+// The smallest kernel radius in pixels, as for the pyramid cells
+const int MinimumScreenKernelRadius = 2;
+
+
+struct ScreenKernel {
+	int   x;
+	int   y;
+	int   radius;
+	float weight;
+};
+
+using ScreenKernels = std::vector<ScreenKernel>;
+
+
+/**
+ * @brief Projects the accumulated events and returns the kernels that
+ *        reach into the area.
+ */
+ScreenKernels screenKernels(const Gui::Map::Canvas *canvas, const QRect &area,
+                            const std::vector<EventHeatLayer::Event> &events) {
+	std::vector<const EventHeatLayer::Event*> sources;
+	std::vector<double> latitudes, longitudes;
+
+	for ( const auto &evt : events ) {
+		if ( evt.accumulated ) {
+			sources.push_back(&evt);
+			latitudes.push_back(evt.location.y());
+			longitudes.push_back(evt.location.x());
+		}
+	}
+
+	int count = static_cast<int>(sources.size());
+	std::vector<int> x(count), y(count);
+	std::vector<quint8> clipped(count, 0);
+
+	BatchProjection projection(canvas);
+	projection.project(x.data(), y.data(), clipped.data(), 1,
+	                   latitudes.data(), longitudes.data(), count);
+
+	// The linear projections also return valid positions outside the
+	// canvas, the kernels of those events might still reach into it
+	bool useClipped = projection.type() != BatchProjection::Generic;
+	float scale = DensityPyramid::kernelScale(canvas->pixelPerDegree());
+	ScreenKernels kernels;
+
+	for ( int i = 0; i < count; ++i ) {
+		if ( clipped[i] && !useClipped ) {
+			continue;
+		}
+
+		int radius = std::max(MinimumScreenKernelRadius,
+		                      static_cast<int>(sources[i]->magnitude * scale));
+		if ( !area.adjusted(-radius, -radius, radius, radius).contains(x[i], y[i]) ) {
+			continue;
+		}
+
+		kernels.push_back({x[i], y[i], radius, sources[i]->weight});
+	}
+
+	return kernels;
+}
+
+
+/**
+ * @brief Adds the parts of the kernels inside the rows [y0, y1) to the
+ *        row-major intensities. Disjoint rows can be updated concurrently.
+ */
+void splatRows(float *intensities, int width, int y0, int y1,
+               const ScreenKernels &kernels) {
+	for ( const auto &kernel : kernels ) {
+		int top = qMax(y0, kernel.y - kernel.radius);
+		int bottom = qMin(y1 - 1, kernel.y + kernel.radius);
+		int radiusSquared = kernel.radius * kernel.radius;
+		// weight * (1 - (dx^2 + dy^2) / radius^2)
+		float scale = kernel.weight / radiusSquared;
+
+		for ( int y = top; y <= bottom; ++y ) {
+			int dy = y - kernel.y;
+			int halfWidth = static_cast<int>(sqrt(static_cast<double>(radiusSquared - dy*dy)));
+			int left = qMax(0, kernel.x - halfWidth);
+			int right = qMin(width - 1, kernel.x + halfWidth);
+			float rowWeight = kernel.weight - scale * (dy*dy);
+			float *row = intensities + static_cast<size_t>(y) * width;
+
+			for ( int x = left; x <= right; ++x ) {
+				int dx = x - kernel.x;
+				row[x] += rowWeight - scale * (dx*dx);
+			}
+		}
+	}
+}
+
+
+inline QRgb compose(QRgb base, QRgb c, bool multiply) {
+	if ( multiply ) {
+		return qRgba((qRed(base)*qRed(c)) / 255,
+		             (qGreen(base)*qGreen(c)) / 255,
+		             (qBlue(base)*qBlue(c)) / 255,
+		             qAlpha(base));
+	}
+
+	int alpha = qAlpha(c);
+	int invertedAlpha = 255-alpha;
+	return qRgba((qRed(base)*invertedAlpha + qRed(c)*alpha) / 255,
+	             (qGreen(base)*invertedAlpha + qGreen(c)*alpha) / 255,
+	             (qBlue(base)*invertedAlpha + qBlue(c)*alpha) / 255,
+	             qAlpha(base));
+}
+
+
+#if defined(__SSE2__)
+// Divides unsigned 16 bit values up to 255*255 by 255
+inline __m128i divideBy255(__m128i v) {
+	return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(v, _mm_set1_epi16(1)),
+	                                    _mm_srli_epi16(v, 8)), 8);
+}
+
+
+inline __m128i composePixels(__m128i base, __m128i c, bool multiply) {
+	if ( multiply ) {
+		return divideBy255(_mm_mullo_epi16(base, c));
+	}
+
+	// Broadcast the alpha of each color to all its channels
+	__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3,3,3,3)),
+	                                    _MM_SHUFFLE(3,3,3,3));
+	__m128i invertedAlpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+	return divideBy255(_mm_add_epi16(_mm_mullo_epi16(base, invertedAlpha),
+	                                 _mm_mullo_epi16(c, alpha)));
+}
+#endif
+
+
+/**
+ * @brief Composes a row of colors into the base buffer. The alpha channel
+ *        of the base is kept. Pixels to be left untouched must be set to
+ *        neutralColor().
+ */
+void composeRow(QRgb *base, const QRgb *colors, int count, bool multiply) {
+	int i = 0;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000));
+
+	for ( ; i + 4 <= count; i += 4 ) {
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + i));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i));
+
+		__m128i low = composePixels(_mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero), multiply);
+		__m128i high = composePixels(_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero), multiply);
+
+		__m128i r = _mm_packus_epi16(low, high);
+		r = _mm_or_si128(_mm_andnot_si128(alphaMask, r), _mm_and_si128(alphaMask, b));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(base + i), r);
+	}
+#endif
+
+	for ( ; i < count; ++i ) {
+		base[i] = compose(base[i], colors[i], multiply);
+	}
+}
+
+
+//! Returns the color that leaves the base unchanged when composed
+inline QRgb neutralColor(bool multiply) {
+	return multiply ? qRgba(255,255,255,255) : qRgba(0,0,0,0);
 }
 
 
@@ -59,10 +374,17 @@ class HeatMapLegend : public Gui::Map::Legend {
 			setArea(Qt::AlignLeft | Qt::AlignBottom);
 			setTitle(tr("Heatmap"));
 			_lowerBound = _upperBound = -1;
+			_caption = tr("Event locations");
 		}
 
 
 	public:
+		void setCaption(const QString &caption) {
+			if ( _caption == caption ) return;
+			_caption = caption;
+			_cache.invalidate();
+		}
+
 		void setGradient(const Gui::Gradient *gradient,
 		                 double lowerBound, double upperBound) {
 			if ( _gradient == gradient && lowerBound == _lowerBound && upperBound == _upperBound )
@@ -73,6 +395,7 @@ class HeatMapLegend : public Gui::Map::Legend {
 			_upperBound = upperBound;
 
 			_items.clear();
+			_cache.invalidate();
 
 			if ( !_gradient || _gradient->isEmpty() ) {
 				setEnabled(false);
@@ -162,6 +485,14 @@ class HeatMapLegend : public Gui::Map::Legend {
 	// ----------------------------------------------------------------------
 	public:
 		virtual void draw(const QRect &r, QPainter &p) {
+			_cache.draw(r, p, [this](const QRect &rect, QPainter &painter) {
+				drawContent(rect, painter);
+			});
+		}
+
+
+	private:
+		void drawContent(const QRect &r, QPainter &p) {
 			int fontHeight = QFontMetricsF(qApp->font()).height();
 			int halfFontHeight = fontHeight/2;
 			int contentY = r.top() + halfFontHeight+fontHeight;
@@ -173,7 +504,7 @@ class HeatMapLegend : public Gui::Map::Legend {
 
 			p.drawText(r.left() + halfFontHeight, r.top() + halfFontHeight,
 			           r.width()-fontHeight, fontHeight,
-			           Qt::AlignCenter, qApp->tr("Event locations"));
+			           Qt::AlignCenter, _caption);
 
 			p.setFont(f);
 			p.drawImage(r.left()+_items.front().x,
@@ -221,6 +552,8 @@ class HeatMapLegend : public Gui::Map::Legend {
 
 		QVector<StringAtPos> _items;
 		QImage _gradientImage;
+		QString _caption;
+		LegendCache _cache;
 };
 
 
@@ -246,6 +579,7 @@ EventHeatLayer::EventHeatLayer(QObject* parent)
 
 	_updateTimer.setSingleShot(true);
 	connect(&_updateTimer, SIGNAL(timeout()), this, SLOT(updateCanvas()));
+	connect(&_playbackTimer, SIGNAL(timeout()), this, SLOT(advancePlayback()));
 
 	_legend = new HeatMapLegend(this);
 	addLegend(_legend);
@@ -269,10 +603,47 @@ void EventHeatLayer::setCompositionMode(bool multiply) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventHeatLayer::setWeighting(Weighting weighting) {
+	if ( _weighting == weighting ) return;
+	_weighting = weighting;
+
+	for ( auto &evt : _events ) {
+		evt.weight = eventWeight(evt.magnitude, _weighting);
+	}
+
+	rebuildDensity();
+
+	HeatMapLegend *legend = static_cast<HeatMapLegend*>(_legend);
+	switch ( _weighting ) {
+		case Magnitude:
+			legend->setCaption(tr("Event magnitudes"));
+			break;
+		case Energy:
+			legend->setCaption(tr("Log. seismic energy"));
+			break;
+		default:
+			legend->setCaption(tr("Event locations"));
+			break;
+	}
+
+	updateCanvas();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void EventHeatLayer::clear() {
-	if ( _events.isEmpty() ) return;
+	if ( _events.empty() ) return;
 	_events.clear();
+	_eventIndex.clear();
+	_timeline.clear();
+	_timelineDirty = false;
+	_playbackFirst = _playbackLast = 0;
+
+	_density.clear();
 
 	if ( !_updateTimer.isActive() )
 		_updateTimer.start(1000);
@@ -284,20 +655,39 @@ void EventHeatLayer::clear() {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void EventHeatLayer::addEvent(DataModel::Event *e, bool) {
-	EventMap::iterator it = _events.find(e->publicID());
+	auto it = _eventIndex.find(e->publicID());
+	if ( it != _eventIndex.end() ) {
+		updateEvent(e);
+		return;
+	}
 
 	DataModel::Origin *org = DataModel::Origin::Find(e->preferredOriginID());
 	if ( org ) {
-		EventPtr evt;
-
-		if ( it == _events.end() ) {
-			evt = new Event();
-			_events[e->publicID()] = evt;
+		int index = static_cast<int>(_events.size());
+		_events.emplace_back();
+		_eventIndex[e->publicID()] = index;
+
+		Event *evt = &_events.back();
+		evt->id = e->publicID();
+		fillEvent(evt, e, org, _weighting);
+
+		// Events usually arrive in order, otherwise the timeline is
+		// sorted on demand
+		if ( !_timelineDirty && (_timeline.empty() || _events[_timeline.back()].time <= evt->time) ) {
+			_timeline.push_back(index);
+			if ( _playback && isInPlaybackWindow(evt) ) {
+				_playbackLast = _timeline.size();
+			}
 		}
 		else
-			evt = it.value();
+			_timelineDirty = true;
 
-		fillEvent(evt.get(), e, org);
+		if ( isInPlaybackWindow(evt) )
+			accumulate(evt);
+
+		if ( _playback ) {
+			anchorPlaybackTime();
+		}
 
 		if ( !_updateTimer.isActive() )
 			_updateTimer.start(1000);
@@ -308,14 +698,73 @@ void EventHeatLayer::addEvent(DataModel::Event *e, bool) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventHeatLayer::addEvents(const std::vector<DataModel::Event*> &events) {
+	DensityPyramid::Kernels kernels;
+	kernels.reserve(events.size());
+
+	_events.reserve(_events.size() + events.size());
+	_eventIndex.reserve(_events.size() + events.size());
+
+	for ( auto e : events ) {
+		if ( _eventIndex.find(e->publicID()) != _eventIndex.end() ) {
+			updateEvent(e);
+			continue;
+		}
+
+		DataModel::Origin *org = DataModel::Origin::Find(e->preferredOriginID());
+		if ( !org ) {
+			continue;
+		}
+
+		int index = static_cast<int>(_events.size());
+		_events.emplace_back();
+		_eventIndex[e->publicID()] = index;
+
+		Event *evt = &_events.back();
+		evt->id = e->publicID();
+		fillEvent(evt, e, org, _weighting);
+
+		if ( isInPlaybackWindow(evt) ) {
+			kernels.push_back({evt->location, evt->magnitude, evt->weight});
+			evt->accumulated = true;
+		}
+	}
+
+	_density.add(kernels);
+
+	// Sorted on demand, the playback range is derived from the
+	// accumulated events
+	_timelineDirty = true;
+
+	if ( _playback ) {
+		anchorPlaybackTime();
+	}
+
+	_updateTimer.stop();
+	updateCanvas();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void EventHeatLayer::updateEvent(DataModel::Event *e) {
-	EventMap::iterator it = _events.find(e->publicID());
-	if ( it == _events.end() ) return;
+	auto it = _eventIndex.find(e->publicID());
+	if ( it == _eventIndex.end() ) return;
 
 	DataModel::Origin *org = DataModel::Origin::Find(e->preferredOriginID());
 	if ( org ) {
-		fillEvent(it.value().get(), e, org);
+		Event *evt = &_events[it->second];
+		release(evt);
+		Core::Time time = evt->time;
+		fillEvent(evt, e, org, _weighting);
+		if ( evt->time != time )
+			_timelineDirty = true;
+
+		if ( isInPlaybackWindow(evt) )
+			accumulate(evt);
 
 		if ( !_updateTimer.isActive() )
 			_updateTimer.start(1000);
@@ -328,9 +777,24 @@ void EventHeatLayer::updateEvent(DataModel::Event *e) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void EventHeatLayer::removeEvent(DataModel::Event *e) {
-	EventMap::iterator it = _events.find(e->publicID());
-	if ( it == _events.end() ) return;
-	_events.erase(it);
+	auto it = _eventIndex.find(e->publicID());
+	if ( it == _eventIndex.end() ) return;
+
+	int index = it->second;
+	release(&_events[index]);
+	_eventIndex.erase(it);
+
+	// Move the last event into the gap
+	if ( index != static_cast<int>(_events.size()) - 1 ) {
+		_events[index] = std::move(_events.back());
+		_eventIndex[_events[index].id] = index;
+	}
+
+	_events.pop_back();
+
+	// The timeline refers to event indexes and is rebuilt with the next
+	// sort
+	_timelineDirty = true;
 
 	if ( !_updateTimer.isActive() )
 		_updateTimer.start(1000);
@@ -340,11 +804,297 @@ void EventHeatLayer::removeEvent(DataModel::Event *e) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventHeatLayer::setPlaybackEnabled(bool enable) {
+	if ( _playback == enable ) return;
+
+	if ( !enable ) {
+		pause();
+	}
+
+	_playback = enable;
+
+	if ( _playback ) {
+		// Start with the first window that contains events
+		Core::TimeWindow range = playbackRange();
+		if ( !_timeline.empty()
+		  && (!_playbackTime.valid() || !range.contains(_playbackTime)) ) {
+			_playbackTime = range.startTime() + _playbackWindow;
+		}
+	}
+
+	rebuildDensity();
+	updateCanvas();
+
+	if ( _playback ) {
+		emit playbackTimeChanged(_playbackTime);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventHeatLayer::setPlaybackWindow(const Core::TimeSpan &length) {
+	if ( _playbackWindow == length ) return;
+	_playbackWindow = length;
+
+	if ( _playback ) {
+		rebuildDensity();
+		updateCanvas();
+		emit playbackTimeChanged(_playbackTime);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventHeatLayer::setPlaybackTime(const Core::Time &end) {
+	if ( !_playback ) {
+		_playbackTime = end;
+		return;
+	}
+
+	updateTimeline();
+
+	auto range = timelineRange(end);
+
+	if ( range.first >= _playbackLast || range.second <= _playbackFirst ) {
+		// The windows do not overlap
+		for ( size_t i = _playbackFirst; i < _playbackLast; ++i ) {
+			release(&_events[_timeline[i]]);
+		}
+	}
+	else {
+		// Only release the events that left the window
+		for ( size_t i = _playbackFirst; i < range.first; ++i ) {
+			release(&_events[_timeline[i]]);
+		}
+		for ( size_t i = range.second; i < _playbackLast; ++i ) {
+			release(&_events[_timeline[i]]);
+		}
+	}
+
+	// Events that are already accumulated are skipped
+	for ( size_t i = range.first; i < range.second; ++i ) {
+		accumulate(&_events[_timeline[i]]);
+	}
+
+	_playbackFirst = range.first;
+	_playbackLast = range.second;
+	_playbackTime = end;
+
+	updateCanvas();
+	emit playbackTimeChanged(_playbackTime);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+Core::TimeWindow EventHeatLayer::playbackRange() {
+	updateTimeline();
+
+	if ( _timeline.empty() ) {
+		return Core::TimeWindow();
+	}
+
+	return Core::TimeWindow(_events[_timeline.front()].time, _events[_timeline.back()].time);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventHeatLayer::play() {
+	if ( !_playback || _events.empty() ) return;
+
+	// Restart from the beginning if the end has been reached
+	if ( !anchorPlaybackTime() ) {
+		Core::TimeWindow range = playbackRange();
+		if ( _playbackTime >= range.endTime() ) {
+			setPlaybackTime(range.startTime() + _playbackWindow);
+		}
+	}
+
+	_playbackTimer.start(PlaybackFrameInterval);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventHeatLayer::pause() {
+	_playbackTimer.stop();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventHeatLayer::advancePlayback() {
+	Core::TimeWindow range = playbackRange();
+
+	// Play the whole range in a fixed duration
+	double step = static_cast<double>(range.length()) * PlaybackFrameInterval
+	            / (PlaybackDuration * 1000.0);
+	Core::Time end = _playbackTime + Core::TimeSpan(qMax(step, 1.0));
+
+	if ( end >= range.endTime() ) {
+		pause();
+		setPlaybackTime(range.endTime());
+		emit playbackFinished();
+		return;
+	}
+
+	setPlaybackTime(end);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool EventHeatLayer::isInPlaybackWindow(const Event *evt) const {
+	if ( !_playback ) return true;
+	return evt->time >= _playbackTime - _playbackWindow && evt->time <= _playbackTime;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool EventHeatLayer::anchorPlaybackTime() {
+	Core::TimeWindow range = playbackRange();
+	if ( _timeline.empty() ) {
+		return false;
+	}
+
+	if ( _playbackTime.valid()
+	  && _playbackTime >= range.startTime()
+	  && _playbackTime - _playbackWindow <= range.endTime() ) {
+		return false;
+	}
+
+	// The accumulated events are released and the new window is
+	// accumulated
+	setPlaybackTime(range.startTime() + _playbackWindow);
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventHeatLayer::accumulate(Event *evt) {
+	if ( evt->accumulated ) return;
+	_density.add(evt->location, evt->magnitude, evt->weight);
+	evt->accumulated = true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventHeatLayer::release(Event *evt) {
+	if ( !evt->accumulated ) return;
+	_density.remove(evt->location, evt->magnitude, evt->weight);
+	evt->accumulated = false;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventHeatLayer::rebuildDensity() {
+	_density.clear();
+
+	for ( auto &evt : _events ) {
+		evt.accumulated = false;
+	}
+
+	if ( _playback ) {
+		updateTimeline();
+		auto range = timelineRange(_playbackTime);
+		for ( size_t i = range.first; i < range.second; ++i ) {
+			accumulate(&_events[_timeline[i]]);
+		}
+		_playbackFirst = range.first;
+		_playbackLast = range.second;
+	}
+	else {
+		for ( auto &evt : _events ) {
+			accumulate(&evt);
+		}
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventHeatLayer::updateTimeline() {
+	if ( !_timelineDirty ) return;
+
+	_timeline.resize(_events.size());
+	for ( size_t i = 0; i < _events.size(); ++i ) {
+		_timeline[i] = static_cast<int>(i);
+	}
+
+	std::stable_sort(_timeline.begin(), _timeline.end(), [this](int a, int b) {
+		return _events[a].time < _events[b].time;
+	});
+
+	_timelineDirty = false;
+
+	// The accumulated events are exactly those inside the current window
+	auto range = timelineRange(_playbackTime);
+	_playbackFirst = range.first;
+	_playbackLast = range.second;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+std::pair<size_t, size_t> EventHeatLayer::timelineRange(const Core::Time &end) const {
+	Core::Time start = end - _playbackWindow;
+
+	auto first = std::lower_bound(_timeline.begin(), _timeline.end(), start,
+	                              [this](int evt, const Core::Time &t) {
+		return _events[evt].time < t;
+	});
+	auto last = std::upper_bound(first, _timeline.end(), end,
+	                             [this](const Core::Time &t, int evt) {
+		return t < _events[evt].time;
+	});
+
+	return std::make_pair(static_cast<size_t>(first - _timeline.begin()),
+	                      static_cast<size_t>(last - _timeline.begin()));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void EventHeatLayer::baseBufferUpdated(Gui::Map::Canvas *canvas, QPainter &painter) {
 	_updateTimer.stop();
 
-	if ( _events.isEmpty() ) {
+	if ( _events.empty() ) {
 		_legend->setEnabled(false);
 		return;
 	}
@@ -352,97 +1102,102 @@ void EventHeatLayer::baseBufferUpdated(Gui::Map::Canvas *canvas, QPainter &paint
 	_legend->setEnabled(true);
 
 	QImage &base = canvas->buffer();
-	QRgb *data = (QRgb*)base.bits();
-
 	int width = base.width();
 	int height = base.height();
-	int numberOfPixels = width*height;
+	if ( width <= 0 || height <= 0 ) return;
 
-	if ( _intensityBuffer.count() != numberOfPixels )
-		_intensityBuffer.resize(numberOfPixels);
+	double pixelPerDegree = canvas->pixelPerDegree();
+	// Energies span many orders of magnitude
+	bool logScale = _weighting == Energy;
 
-	_intensityBuffer.fill(0);
+	// The intensity of each pixel, the bands are computed in parallel
+	std::vector<float> intensities(static_cast<size_t>(width) * height, 0.0f);
+	int bandCount = (height + HeatMapBandHeight - 1) / HeatMapBandHeight;
 
-	EventMap::iterator it;
+	if ( DensityPyramid::isResolved(pixelPerDegree) ) {
+		// Resample the pyramid level matching the current scale
+		const DensityPyramid::Level &density =
+			_density.level(DensityPyramid::selectLevel(pixelPerDegree));
+		ScreenGeoGrid grid(canvas->projection(), width, height);
 
-	float diameterScale = 4*(1+log(qMax(1.0f, canvas->pixelPerDegree())));
+		parallelFor(bandCount, [&](int band) {
+			std::vector<double> longitudes(width), latitudes(width);
+			std::vector<quint8> valid(width);
 
-	float *intensityData = _intensityBuffer.data();
-	for ( it = _events.begin(); it != _events.end(); ++it ) {
-		Event *evt = it.value().get();
-		QPoint coords;
-		if ( !canvas->projection()->project(coords, evt->location) )
-			continue;
+			int y0 = band * HeatMapBandHeight;
+			int y1 = qMin(y0 + HeatMapBandHeight, height);
+
+			for ( int y = y0; y < y1; ++y ) {
+				grid.unprojectRow(y, longitudes.data(), latitudes.data(), valid.data());
+				float *row = intensities.data() + static_cast<size_t>(y) * width;
 
-		int cx = coords.x();
-		int cy = coords.y();
-		int diameter = qMax(2, (int)(evt->magnitude*diameterScale));
-		//float intensityScale = qMax(0.02f, evt->magnitude*0.02f);
-		//float intensityScale = log10(qMax(1.0f, evt->magnitude))*0.1;
-		float intensityScale = 1.0f;
-
-		int x0 = cx-diameter;
-		int y0 = cy-diameter;
-		int x1 = cx+diameter+1;
-		int y1 = cy+diameter+1;
-
-		if ( x0 < 0 ) x0 = 0; else if ( x0 >= width ) continue;
-		if ( x1 <= 0 ) continue; else if ( x1 > width ) x1 = width;
-		if ( y0 < 0 ) y0 = 0; else if ( y0 >= height ) continue;
-		if ( y1 <= 0 ) continue; else if ( y1 > height ) y1 = height;
-
-		int ofs = y0*width+x0;
-		int pw = x1-x0;
-		int ph = y1-y0;
-
-		int diameterSquared = diameter*diameter;
-
-		for ( int y = 0, ry = y0-cy; y < ph; ++y, ++ry, ofs += width ) {
-			for ( int x = 0, rx = x0-cx; x < pw; ++x, ++rx ) {
-				int distanceSquared = rx*rx + ry*ry;
-				if ( distanceSquared > diameterSquared ) continue;
-				intensityData[ofs+x] += intensityScale*(1.0f - (float)distanceSquared/(float)diameterSquared);
+				for ( int x = 0; x < width; ++x ) {
+					if ( valid[x] ) {
+						row[x] = DensityPyramid::sample(density, longitudes[x], latitudes[x]);
+					}
+				}
 			}
-		}
+		});
 	}
-
-#if 1
-	float maxIntensity = 0;
-	for ( int i = 0; i < numberOfPixels; ++i ) {
-		if ( intensityData[i] > maxIntensity )
-			maxIntensity = intensityData[i];
+	else {
+		// The cells of the finest level are larger than the kernels
+		// should be at this scale, draw the kernels on screen
+		ScreenKernels kernels = screenKernels(canvas, base.rect(), _events);
+
+		parallelFor(bandCount, [&](int band) {
+			int y0 = band * HeatMapBandHeight;
+			int y1 = qMin(y0 + HeatMapBandHeight, height);
+			splatRows(intensities.data(), width, y0, y1, kernels);
+		});
 	}
 
-	maxIntensity = ceil(maxIntensity);
-	float intensityScale = _gradientLUT.upperBound() / maxIntensity;
-#else
-	float intensityScale = 1.0f;
-#endif
+	// The intensity range is taken from the visible area
+	std::vector<float> bandMaxima(bandCount, 0.0f);
 
-	if ( _composeMultiply ) {
-		for ( int i = 0; i < numberOfPixels; ++i, ++data, ++intensityData ) {
-			if ( *intensityData > 0 ) {
-				QRgb c = _gradientLUT.valueAt(*intensityData*intensityScale);
-				*data = qRgba((qRed(*data)*qRed(c)) / 255,
-				              (qGreen(*data)*qGreen(c)) / 255,
-				              (qBlue(*data)*qBlue(c)) / 255,
-				              qAlpha(*data));
-			}
+	parallelFor(bandCount, [&](int band) {
+		int y0 = band * HeatMapBandHeight;
+		int y1 = qMin(y0 + HeatMapBandHeight, height);
+		float *values = intensities.data() + static_cast<size_t>(y0) * width;
+		int count = (y1 - y0) * width;
+		float maximum = 0;
+
+		for ( int i = 0; i < count; ++i ) {
+			if ( logScale && values[i] > 0 ) values[i] = log10f(1 + values[i]);
+			if ( values[i] > maximum ) maximum = values[i];
 		}
-	}
-	else {
-		for ( int i = 0; i < numberOfPixels; ++i, ++data, ++intensityData ) {
-			if ( *intensityData > 0 ) {
-				QRgb c = _gradientLUT.valueAt(*intensityData*intensityScale);
-				int alpha = qAlpha(c);
-				int invertedAlpha = 255-alpha;
-				*data = qRgba((qRed(*data)*invertedAlpha + qRed(c)*alpha) / 255,
-				              (qGreen(*data)*invertedAlpha + qGreen(c)*alpha) / 255,
-				              (qBlue(*data)*invertedAlpha + qBlue(c)*alpha) / 255,
-				              qAlpha(*data));
+
+		bandMaxima[band] = maximum;
+	});
+
+	float maxIntensity = ceil(*std::max_element(bandMaxima.begin(), bandMaxima.end()));
+	if ( maxIntensity <= 0 ) maxIntensity = 1;
+	float intensityScale = _gradientLUT.upperBound() / maxIntensity;
+
+	QRgb neutral = neutralColor(_composeMultiply);
+	bool multiply = _composeMultiply;
+
+	// Fetch the pixels once, scanLine() would try to detach in each band
+	uchar *bits = base.bits();
+	int bytesPerLine = static_cast<int>(base.bytesPerLine());
+
+	// Bands are written directly into disjoint rows of the canvas buffer
+	parallelFor(bandCount, [&](int band) {
+		std::vector<QRgb> colors(width);
+
+		int y0 = band * HeatMapBandHeight;
+		int y1 = qMin(y0 + HeatMapBandHeight, height);
+
+		for ( int y = y0; y < y1; ++y ) {
+			const float *row = intensities.data() + static_cast<size_t>(y) * width;
+
+			for ( int x = 0; x < width; ++x ) {
+				colors[x] = row[x] > 0 ? _gradientLUT.valueAt(row[x]*intensityScale) : neutral;
 			}
+
+			composeRow(reinterpret_cast<QRgb*>(bits + y*bytesPerLine),
+			           colors.data(), width, multiply);
 		}
-	}
+	});
 
 	static_cast<HeatMapLegend*>(_legend)->setGradient(&_gradient, 0, maxIntensity);
 }
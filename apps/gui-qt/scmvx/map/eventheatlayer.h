@@ -29,6 +29,11 @@
 #endif
 #include <QTimer>
 
+#include <unordered_map>
+#include <vector>
+
+#include "densitypyramid.h"
+
 
 namespace Seiscomp::MapViewX {
 
@@ -36,10 +41,55 @@ namespace Seiscomp::MapViewX {
 class EventHeatLayer : public Gui::Map::Layer {
 	Q_OBJECT
 
+	public:
+		//! Defines what an event contributes to the heat map
+		enum Weighting {
+			//! Each event contributes equally
+			Count,
+			//! Events are weighted with their magnitude
+			Magnitude,
+			//! Events are weighted with their radiated energy, shown in
+			//! logarithmic scale
+			Energy
+		};
+
+
 	public:
 		EventHeatLayer(QObject* parent);
 
 
+	public:
+		void setWeighting(Weighting weighting);
+		Weighting weighting() const { return _weighting; }
+
+		/**
+		 * @brief Adds many events at once, e.g. when loading a catalog.
+		 *        The density is updated in a single pass and the canvas
+		 *        is updated once at the end.
+		 */
+		void addEvents(const std::vector<DataModel::Event*> &events);
+
+
+	// ----------------------------------------------------------------------
+	//  Playback
+	// ----------------------------------------------------------------------
+	public:
+		/**
+		 * @brief Sets the length of the time window shown during
+		 *        playback.
+		 */
+		void setPlaybackWindow(const Core::TimeSpan &length);
+		const Core::TimeSpan &playbackWindow() const { return _playbackWindow; }
+
+		//! Returns the end time of the current playback window
+		const Core::Time &playbackTime() const { return _playbackTime; }
+
+		//! Returns the origin times of the earliest and latest event
+		Core::TimeWindow playbackRange();
+
+		bool isPlaying() const { return _playbackTimer.isActive(); }
+
+
 	// ----------------------------------------------------------------------
 	//  Slots
 	// ----------------------------------------------------------------------
@@ -51,8 +101,30 @@ class EventHeatLayer : public Gui::Map::Layer {
 
 		void setCompositionMode(bool);
 
+		/**
+		 * @brief Enables the time-lapse mode. Only events inside the
+		 *        playback window are accumulated while it is enabled.
+		 */
+		void setPlaybackEnabled(bool);
+
+		/**
+		 * @brief Moves the end of the playback window. Only the events
+		 *        crossing the window borders are added or removed.
+		 */
+		void setPlaybackTime(const Seiscomp::Core::Time &end);
+
+		void play();
+		void pause();
+
+
+	signals:
+		void playbackTimeChanged(const Seiscomp::Core::Time &end);
+		void playbackFinished();
+
+
 	private slots:
 		void updateCanvas();
+		void advancePlayback();
 
 
 	public:
@@ -61,28 +133,67 @@ class EventHeatLayer : public Gui::Map::Layer {
 		void setVisible(bool) override;
 
 
+	public:
+		struct Event {
+			std::string id;
+			QPointF     location;
+			float       magnitude;
+			Core::Time  time;
+			//! The kernel factor according to the weighting mode
+			float       weight{1};
+			//! Whether the kernel is part of the density pyramid
+			bool        accumulated{false};
+		};
+
+
 	private:
 		void generateLUT();
 
+		bool isInPlaybackWindow(const Event *evt) const;
+		/**
+		 * @brief Moves the playback window to the start of the event
+		 *        range if it does not overlap the range, e.g. if playback
+		 *        has been enabled before events were added.
+		 * @return Whether the playback time has been changed
+		 */
+		bool anchorPlaybackTime();
+		void accumulate(Event *evt);
+		void release(Event *evt);
+		void rebuildDensity();
 
-	public:
-		DEFINE_SMARTPOINTER(Event);
-		struct Event : public Core::BaseObject {
-			QPointF location;
-			float   magnitude;
-		};
+		//! Sorts the timeline by origin time if required
+		void updateTimeline();
+		//! Returns the timeline range of a playback window
+		std::pair<size_t, size_t> timelineRange(const Core::Time &end) const;
 
 
 	private:
-		using EventMap = QMap<std::string, EventPtr>;
-		EventMap                   _events;
-
-		QVector<float>             _intensityBuffer;
+		using Events = std::vector<Event>;
+		using EventIndex = std::unordered_map<std::string, int>;
+		using Timeline = std::vector<int>;
+
+		Events                     _events;
+		//! Maps public IDs to indexes into _events
+		EventIndex                 _eventIndex;
+		//! All event indexes ordered by origin time
+		Timeline                   _timeline;
+		bool                       _timelineDirty{false};
+
+		DensityPyramid             _density;
 		Gui::Gradient              _gradient;
 		Gui::StaticColorLUT<1024>  _gradientLUT;
 		bool                       _composeMultiply;
+		Weighting                  _weighting{Count};
 		QTimer                     _updateTimer;
 		Gui::Map::Legend          *_legend;
+
+		bool                       _playback{false};
+		Core::TimeSpan             _playbackWindow{30 * 86400, 0};
+		Core::Time                 _playbackTime;
+		//! The timeline range of the accumulated events during playback
+		size_t                     _playbackFirst{0};
+		size_t                     _playbackLast{0};
+		QTimer                     _playbackTimer;
 };
 
 
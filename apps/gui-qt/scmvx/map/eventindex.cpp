@@ -0,0 +1,134 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <cstddef>
+
+#include "eventindex.h"
+
+
+namespace Seiscomp::MapViewX {
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventScreenIndex::clear() {
+	_columns = _rows = 0;
+	_radius = 0;
+	_drawList.clear();
+	_cellOffsets.clear();
+	_cellItems.clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventScreenIndex::build(const QSize &size, Items &items, int maxPerCell, int radius) {
+	_columns = std::max(1, (size.width() + CellSize - 1) / CellSize);
+	_rows = std::max(1, (size.height() + CellSize - 1) / CellSize);
+	_radius = radius;
+
+	for ( auto &item : items ) {
+		item.cell = row(item.pos.y()) * _columns + column(item.pos.x());
+	}
+
+	// Group the items by cell with the largest magnitudes first
+	std::sort(items.begin(), items.end(), [](const Item &a, const Item &b) {
+		if ( a.cell != b.cell ) {
+			return a.cell < b.cell;
+		}
+		if ( a.magnitude != b.magnitude ) {
+			return a.magnitude > b.magnitude;
+		}
+		return a.index < b.index;
+	});
+
+	// Keep the first maxPerCell items of each cell
+	Items::iterator last = items.begin();
+	for ( auto it = items.begin(); it != items.end(); ) {
+		auto end = it;
+		while ( end != items.end() && end->cell == it->cell ) {
+			++end;
+		}
+
+		auto keep = it + std::min<std::ptrdiff_t>(end - it, maxPerCell);
+		last = std::move(it, keep, last);
+		it = end;
+	}
+
+	items.erase(last, items.end());
+
+	// Restore the insertion order for drawing
+	std::sort(items.begin(), items.end(), [](const Item &a, const Item &b) {
+		return a.index < b.index;
+	});
+
+	int cells = _columns * _rows;
+	_drawList.resize(items.size());
+	_cellItems.resize(items.size());
+	_cellOffsets.assign(cells + 1, 0);
+
+	for ( const auto &item : items ) {
+		++_cellOffsets[item.cell + 1];
+	}
+
+	for ( int c = 0; c < cells; ++c ) {
+		_cellOffsets[c + 1] += _cellOffsets[c];
+	}
+
+	std::vector<int> fill(_cellOffsets.begin(), _cellOffsets.end() - 1);
+
+	for ( int i = 0; i < static_cast<int>(items.size()); ++i ) {
+		_drawList[i] = items[i].index;
+		_cellItems[fill[items[i].cell]++] = i;
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+int EventScreenIndex::column(int x) const {
+	return qBound(0, x / CellSize, _columns - 1);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+int EventScreenIndex::row(int y) const {
+	return qBound(0, y / CellSize, _rows - 1);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -0,0 +1,159 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+
+#ifndef SEISCOMP_MAPVIEWX_EVENTINDEX_H
+#define SEISCOMP_MAPVIEWX_EVENTINDEX_H
+
+
+#include <QPoint>
+#include <QSize>
+
+#include <vector>
+
+
+namespace Seiscomp::MapViewX {
+
+
+/**
+ * @brief Screen space grid of projected event symbols.
+ *
+ * The index is built from the visible symbols after each projection
+ * change. It thins out crowded areas by keeping only the events with the
+ * largest magnitudes of each grid cell and provides the resulting draw
+ * list. Hit tests only visit the cells covered by the largest symbol
+ * around the queried position.
+ */
+class EventScreenIndex {
+	// ----------------------------------------------------------------------
+	//  Public types
+	// ----------------------------------------------------------------------
+	public:
+		static const int CellSize = 32;
+
+		struct Item {
+			//! The screen position of the symbol
+			QPoint  pos;
+			float   magnitude;
+			//! The index of the event in the layer
+			int     index;
+			//! The grid cell, set by build()
+			int     cell;
+		};
+
+		using Items = std::vector<Item>;
+
+
+	// ----------------------------------------------------------------------
+	//  Public interface
+	// ----------------------------------------------------------------------
+	public:
+		void clear();
+
+		/**
+		 * @brief Rebuilds the index.
+		 * @param size The size of the canvas
+		 * @param items The visible symbols, the array is reordered. All
+		 *              positions must lie within the canvas grown by
+		 *              radius.
+		 * @param maxPerCell The maximum number of events kept per cell. If
+		 *                   a cell holds more events, only the events with
+		 *                   the largest magnitudes are kept.
+		 * @param radius The maximum distance of a symbol outline from the
+		 *               symbol position in pixels
+		 */
+		void build(const QSize &size, Items &items, int maxPerCell, int radius);
+
+		/**
+		 * @brief Returns the indexes of the events to be drawn in
+		 *        ascending order.
+		 */
+		const std::vector<int> &drawList() const { return _drawList; }
+
+		/**
+		 * @brief Returns the topmost event for which isInside returns true.
+		 * @param pos The screen position
+		 * @param isInside Called with the index of each candidate event
+		 * @return The index of the event or -1
+		 */
+		template <typename F>
+		int find(const QPoint &pos, F isInside) const;
+
+
+	// ----------------------------------------------------------------------
+	//  Private methods
+	// ----------------------------------------------------------------------
+	private:
+		int column(int x) const;
+		int row(int y) const;
+
+
+	// ----------------------------------------------------------------------
+	//  Private members
+	// ----------------------------------------------------------------------
+	private:
+		int               _columns{0};
+		int               _rows{0};
+		int               _radius{0};
+		std::vector<int>  _drawList;
+		//! Offsets into _cellItems for each cell plus the end offset
+		std::vector<int>  _cellOffsets;
+		//! Positions in _drawList grouped by cell in ascending order
+		std::vector<int>  _cellItems;
+};
+
+
+template <typename F>
+int EventScreenIndex::find(const QPoint &pos, F isInside) const {
+	if ( _drawList.empty() ) {
+		return -1;
+	}
+
+	int c0 = column(pos.x() - _radius), c1 = column(pos.x() + _radius);
+	int r0 = row(pos.y() - _radius), r1 = row(pos.y() + _radius);
+	int best = -1;
+
+	for ( int r = r0; r <= r1; ++r ) {
+		for ( int c = c0; c <= c1; ++c ) {
+			int cell = r * _columns + c;
+
+			// Items are stored in drawing order, test the topmost first
+			for ( int i = _cellOffsets[cell + 1] - 1; i >= _cellOffsets[cell]; --i ) {
+				int item = _cellItems[i];
+				if ( item <= best ) {
+					break;
+				}
+
+				if ( isInside(_drawList[item]) ) {
+					best = item;
+					break;
+				}
+			}
+		}
+	}
+
+	return best >= 0 ? _drawList[best] : -1;
+}
+
+
+}
+
+
+#endif
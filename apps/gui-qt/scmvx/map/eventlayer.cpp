@@ -28,12 +28,17 @@
 #include <seiscomp/math/tensor.h>
 #include <seiscomp/gui/core/application.h>
 #include <seiscomp/gui/datamodel/eventlayer.h>
-#include <seiscomp/gui/datamodel/ttdecorator.h>
+#include <seiscomp/gui/map/canvas.h>
 
 #include <QMenu>
 #include <QMouseEvent>
 
+#include <algorithm>
+#include <limits>
+
+#include "batchprojection.h"
 #include "eventlayer.h"
+#include "wavefrontdecorator.h"
 
 
 using namespace Seiscomp::DataModel;
@@ -45,9 +50,15 @@ namespace Seiscomp::MapViewX {
 namespace {
 
 
+// The maximum number of events drawn per cell of the screen index. Crowded
+// cells only show the events with the largest magnitudes.
+const int MaxEventsPerCell = 8;
+
+
 void updateSymbol(DataModel::PublicObjectCache *cache,
-                  Map::Canvas *canvas, Gui::EventLayer::EventSymbol &symbol,
+                  Map::Canvas *canvas, EventLayer::EventEntry &entry,
                   Event *event, Origin *org, FocalMechanism *fm) {
+	auto &symbol = entry.symbol;
 	double latitude = org->latitude();
 	double longitude = org->longitude();
 	double depth = 10;
@@ -98,29 +109,47 @@ void updateSymbol(DataModel::PublicObjectCache *cache,
 	Core::Time originTime;
 	originTime = org->time().value();
 
+	entry.location = QPointF(longitude, latitude);
+	entry.magnitude = static_cast<float>(M);
+	entry.depth = static_cast<float>(depth);
+	entry.time = originTime;
+
 	if ( Core::Time::UTC() - originTime < Core::TimeSpan(30 * 60, 0) ) {
-		// Consider the symbol for TT decorator
+		// Consider the symbol for the wavefront decorator
 		if ( !symbol.origin->decorator() ) {
-			symbol.origin->setDecorator(new TTDecorator());
+			symbol.origin->setDecorator(new WavefrontDecorator());
 		}
 
-		TTDecorator *d = static_cast<TTDecorator*>(symbol.origin->decorator());
+		auto d = static_cast<WavefrontDecorator*>(symbol.origin->decorator());
 		d->setLatitude(latitude);
 		d->setLongitude(longitude);
 		d->setDepth(depth);
-		d->setPreferredMagnitudeValue(M);
 		d->setOriginTime(originTime);
 	}
 	else if ( symbol.origin->decorator() ) {
-		if ( !symbol.origin->decorator()->isVisible() ) {
+		if ( static_cast<WavefrontDecorator*>(symbol.origin->decorator())->isExpired() ) {
 			symbol.origin->setDecorator(nullptr);
 		}
 	}
 
+	if ( symbol.origin->decorator() ) {
+		entry.flags |= EventLayer::Decorated;
+	}
+	else {
+		entry.flags &= ~EventLayer::Decorated;
+	}
+
 	if ( canvas ) {
 		symbol.origin->calculateMapPosition(canvas);
 	}
 
+	if ( symbol.origin->isClipped() ) {
+		entry.flags |= EventLayer::Clipped;
+	}
+	else {
+		entry.flags &= ~EventLayer::Clipped;
+	}
+
 	if ( np ) {
 		np->strike().value();
 		np->dip().value();
@@ -192,6 +221,17 @@ EventLayer::EventLayer(QObject* parent, DataModel::PublicObjectCache *cache)
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+EventLayer::~EventLayer() {
+	for ( auto &entry : _events ) {
+		entry.symbol.free();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void EventLayer::setCurrentEvent(DataModel::Event *evt) {
 	auto lastCurrent = _currentEvent;
@@ -201,16 +241,14 @@ void EventLayer::setCurrentEvent(DataModel::Event *evt) {
 		_currentEvent->setDepth(_currentEvent->depth());
 	}
 
-	if ( !evt ) {
-		_currentEvent = nullptr;
-	}
-	else {
-		auto it = _eventSymbols.find(evt->publicID());
-		if ( it == _eventSymbols.end() ) {
-			_currentEvent = nullptr;
-		}
-		else {
-			_currentEvent = it.value().origin;
+	_currentEvent = nullptr;
+	_currentEventId.clear();
+
+	if ( evt ) {
+		auto it = _eventIndex.find(evt->publicID());
+		if ( it != _eventIndex.end() ) {
+			_currentEvent = _events[it->second].symbol.origin;
+			_currentEventId = evt->publicID();
 		}
 	}
 
@@ -225,7 +263,22 @@ void EventLayer::setCurrentEvent(DataModel::Event *evt) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 int EventLayer::eventCount() const {
-	return _eventSymbols.size();
+	return static_cast<int>(_events.size());
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventLayer::setThinningScale(double pixelPerDegree) {
+	if ( _thinningScale == pixelPerDegree ) {
+		return;
+	}
+
+	_thinningScale = pixelPerDegree;
+	_screenIndexDirty = true;
+	emit updateRequested();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -234,18 +287,19 @@ int EventLayer::eventCount() const {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void EventLayer::draw(const Map::Canvas *canvas, QPainter &p) {
-	EventSymbol *currentSymbol = nullptr;
+	if ( _screenIndexDirty ) {
+		updateScreenIndex();
+	}
 
-	// Render all symbols
-	for ( auto &symbol : _eventSymbols ) {
+	// Render the visible symbols, the index has culled clipped symbols
+	// and thinned out crowded areas already
+	for ( int index : _screenIndex.drawList() ) {
+		auto &symbol = _events[index].symbol;
 		if ( symbol.origin == _currentEvent ) {
-			currentSymbol = &symbol;
 			continue;
 		}
 
-		if ( !symbol.origin->isClipped() && symbol.origin->isVisible() ) {
-			symbol.origin->draw(canvas, p);
-		}
+		symbol.origin->draw(canvas, p);
 
 		if ( symbol.tensor ) {
 			if ( !symbol.tensor->isClipped() && symbol.tensor->isVisible() ) {
@@ -254,10 +308,13 @@ void EventLayer::draw(const Map::Canvas *canvas, QPainter &p) {
 		}
 	}
 
-	if ( currentSymbol ) {
-		auto &symbol = *currentSymbol;
+	// The current event is drawn on top even if it has been thinned out
+	auto it = _currentEvent ? _eventIndex.find(_currentEventId) : _eventIndex.end();
+	if ( it != _eventIndex.end() ) {
+		const auto &entry = _events[it->second];
+		const auto &symbol = entry.symbol;
 
-		if ( !symbol.origin->isClipped() && symbol.origin->isVisible() ) {
+		if ( !(entry.flags & Clipped) && symbol.origin->isVisible() ) {
 			symbol.origin->draw(canvas, p);
 		}
 
@@ -273,27 +330,98 @@ void EventLayer::draw(const Map::Canvas *canvas, QPainter &p) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventLayer::calculateMapPosition(const Map::Canvas *canvas) {
+	calculateMapPosition(canvas, 0, static_cast<int>(_events.size()));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventLayer::calculateMapPosition(const Map::Canvas *canvas, int first, int last) {
+	int count = last - first;
+	std::vector<double> latitudes(count), longitudes(count);
+	std::vector<int> x(count), y(count);
+	std::vector<quint8> flags(count, 0);
+
+	for ( int i = 0; i < count; ++i ) {
+		latitudes[i] = _events[first + i].location.y();
+		longitudes[i] = _events[first + i].location.x();
+	}
+
+	// Cull events outside the visible area before projecting their symbols
+	BatchProjection(canvas).project(x.data(), y.data(), flags.data(), Clipped,
+	                                latitudes.data(), longitudes.data(), count);
+
+	for ( int i = 0; i < count; ++i ) {
+		auto &entry = _events[first + i];
+
+		if ( flags[i] & Clipped ) {
+			entry.flags |= Clipped;
+		}
+		else {
+			entry.symbol.origin->calculateMapPosition(canvas);
+			if ( entry.symbol.origin->isClipped() ) {
+				entry.flags |= Clipped;
+			}
+			else {
+				entry.flags &= ~Clipped;
+			}
+		}
+
+		if ( entry.symbol.tensor ) {
+			entry.symbol.tensor->calculateMapPosition(canvas);
+		}
+	}
+
+	_canvasSize = QSize(canvas->width(), canvas->height());
+	_pixelPerDegree = canvas->pixelPerDegree();
+	_screenIndexDirty = true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool EventLayer::isInside(const QMouseEvent *event, const QPointF &geoPos) {
 	int x = event->pos().x();
 	int y = event->pos().y();
-	auto it = _eventSymbols.end();
+	int index = -1;
 
-	while ( it != _eventSymbols.begin() ) {
-		--it;
-		if ( it.value().origin->isClipped() || !it.value().origin->isVisible() ) {
-			continue;
-		}
-		if ( it.value().origin->isInside(x, y) ) {
-			_hoverChanged = _hoverId != it.key();
-			if ( _hoverChanged ) {
-				setHoverId(it.key());
-			}
-			return true;
+	if ( _screenIndexDirty ) {
+		updateScreenIndex();
+	}
+
+	// The current event is drawn on top and tested first
+	auto it = _currentEvent ? _eventIndex.find(_currentEventId) : _eventIndex.end();
+	if ( it != _eventIndex.end() ) {
+		const auto &entry = _events[it->second];
+		if ( !(entry.flags & Clipped) && _currentEvent->isVisible()
+		  && _currentEvent->isInside(x, y) ) {
+			index = it->second;
 		}
 	}
 
-	return false;
+	if ( index < 0 ) {
+		index = _screenIndex.find(event->pos(), [this, x, y](int i) {
+			return _events[i].symbol.origin->isInside(x, y);
+		});
+	}
+
+	if ( index < 0 ) {
+		return false;
+	}
+
+	const auto &id = _events[index].id;
+	_hoverChanged = _hoverId != id;
+	if ( _hoverChanged ) {
+		setHoverId(id);
+	}
+
+	return true;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -351,6 +479,18 @@ bool EventLayer::filterMouseReleaseEvent(QMouseEvent *event, const QPointF &) {
 void EventLayer::clear() {
 	_currentEvent = nullptr;
 	setHoverId(std::string());
+
+	for ( auto &entry : _events ) {
+		entry.symbol.free();
+	}
+
+	_events.clear();
+	_eventIndex.clear();
+	_decoratedEvents.clear();
+	_currentEventId.clear();
+	_screenIndex.clear();
+	_screenIndexDirty = true;
+
 	Gui::EventLayer::clear();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -360,30 +500,42 @@ void EventLayer::clear() {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void EventLayer::addEvent(Event *e, bool) {
-	auto it = _eventSymbols.find(e->publicID());
-
-	OriginPtr org = _cache ? _cache->get<Origin>(e->preferredOriginID()) : Origin::Find(e->preferredOriginID());
-	FocalMechanismPtr fm;
-	if ( !e->preferredFocalMechanismID().empty() ) {
-		fm = _cache ? _cache->get<FocalMechanism>(e->preferredFocalMechanismID()) : FocalMechanism::Find(e->preferredFocalMechanismID());
+	if ( storeEvent(e, canvas()) ) {
+		emit updateRequested();
 	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
 
-	if ( org ) {
-		EventSymbol symbol;
 
-		if ( it != _eventSymbols.end() ) {
-			symbol = it.value();
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventLayer::addEvents(const std::vector<DataModel::Event*> &events) {
+	_events.reserve(_events.size() + events.size());
+	_eventIndex.reserve(_events.size() + events.size());
+
+	int first = static_cast<int>(_events.size());
+	int stored = 0;
+
+	for ( auto e : events ) {
+		// Events already on the map are projected right away, new ones
+		// are appended and projected in one batch below
+		bool known = _eventIndex.find(e->publicID()) != _eventIndex.end();
+		if ( storeEvent(e, known ? canvas() : nullptr) ) {
+			++stored;
 		}
+	}
 
-		updateSymbol(_cache, canvas(), symbol, e, org.get(), fm.get());
-		_eventSymbols[e->publicID()] = symbol;
+	if ( !stored ) {
+		return;
+	}
 
-		// Create origin symbol and register it
-		emit updateRequested();
+	int last = static_cast<int>(_events.size());
+	if ( canvas() && (first < last) ) {
+		calculateMapPosition(canvas(), first, last);
 	}
-	else
-		SEISCOMP_ERROR("Origin %s for event %s not found",
-		               e->preferredOriginID().c_str(), e->publicID().c_str());
+
+	emit updateRequested();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -391,24 +543,57 @@ void EventLayer::addEvent(Event *e, bool) {
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-void EventLayer::updateEvent(Event *e) {
-	auto it = _eventSymbols.find(e->publicID());
-	if ( it == _eventSymbols.end() ) {
-		return;
+bool EventLayer::storeEvent(Event *e, Map::Canvas *canvas) {
+	OriginPtr org = _cache ? _cache->get<Origin>(e->preferredOriginID()) : Origin::Find(e->preferredOriginID());
+	if ( !org ) {
+		SEISCOMP_ERROR("Origin %s for event %s not found",
+		               e->preferredOriginID().c_str(), e->publicID().c_str());
+		return false;
 	}
 
-	OriginPtr org = _cache ? _cache->get<Origin>(e->preferredOriginID()) : Origin::Find(e->preferredOriginID());
 	FocalMechanismPtr fm;
 	if ( !e->preferredFocalMechanismID().empty() ) {
 		fm = _cache ? _cache->get<FocalMechanism>(e->preferredFocalMechanismID()) : FocalMechanism::Find(e->preferredFocalMechanismID());
 	}
 
-	if ( org ) {
-		auto oldOriginSymbol = it.value().origin;
-		updateSymbol(_cache, canvas(), it.value(), e, org.get(), fm.get());
-		if ( _currentEvent == oldOriginSymbol ) {
-			_currentEvent = it.value().origin;
-		}
+	auto it = _eventIndex.find(e->publicID());
+	EventEntry *entry;
+
+	if ( it == _eventIndex.end() ) {
+		_eventIndex[e->publicID()] = static_cast<int>(_events.size());
+		_events.emplace_back();
+		entry = &_events.back();
+		entry->id = e->publicID();
+	}
+	else {
+		entry = &_events[it->second];
+	}
+
+	auto oldOriginSymbol = entry->symbol.origin;
+	bool wasDecorated = entry->flags & Decorated;
+	updateSymbol(_cache, canvas, *entry, e, org.get(), fm.get());
+	if ( !wasDecorated && (entry->flags & Decorated) ) {
+		_decoratedEvents.push_back(entry->id);
+	}
+	if ( oldOriginSymbol && (_currentEvent == oldOriginSymbol) ) {
+		_currentEvent = entry->symbol.origin;
+	}
+
+	_screenIndexDirty = true;
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventLayer::updateEvent(Event *e) {
+	if ( _eventIndex.find(e->publicID()) == _eventIndex.end() ) {
+		return;
+	}
+
+	if ( storeEvent(e, canvas()) ) {
 		emit updateRequested();
 	}
 }
@@ -419,15 +604,39 @@ void EventLayer::updateEvent(Event *e) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void EventLayer::removeEvent(Event *e) {
-	auto it = _eventSymbols.find(e->publicID());
-	if ( it == _eventSymbols.end() ) {
+	auto it = _eventIndex.find(e->publicID());
+	if ( it == _eventIndex.end() ) {
 		return;
 	}
-	if ( it.value().origin == _currentEvent ) {
+
+	int index = it->second;
+	auto &entry = _events[index];
+
+	if ( entry.symbol.origin == _currentEvent ) {
 		_currentEvent = nullptr;
+		_currentEventId.clear();
 	}
-	it.value().free();
-	_eventSymbols.erase(it);
+
+	if ( entry.flags & Decorated ) {
+		auto decorated = std::find(_decoratedEvents.begin(),
+		                           _decoratedEvents.end(), entry.id);
+		if ( decorated != _decoratedEvents.end() ) {
+			_decoratedEvents.erase(decorated);
+		}
+	}
+
+	entry.symbol.free();
+	_eventIndex.erase(it);
+
+	// Move the last entry into the gap to keep the array dense
+	int last = static_cast<int>(_events.size()) - 1;
+	if ( index != last ) {
+		entry = std::move(_events[last]);
+		_eventIndex[entry.id] = index;
+	}
+
+	_events.pop_back();
+	_screenIndexDirty = true;
 	emit updateRequested();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -438,14 +647,29 @@ void EventLayer::removeEvent(Event *e) {
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void EventLayer::tick() {
 	bool hasActiveDecorators = false;
-	auto it = _eventSymbols.begin();
-	for ( ; it != _eventSymbols.end(); ++it ) {
-		if ( it.value().origin->decorator() ) {
-			if ( !it.value().origin->decorator()->isVisible() ) {
-				it.value().origin->setDecorator(nullptr);
-			}
-			else
-				hasActiveDecorators = true;
+
+	// Only visit the events carrying a decorator and drop the expired ones
+	for ( auto it = _decoratedEvents.begin(); it != _decoratedEvents.end(); ) {
+		auto indexIt = _eventIndex.find(*it);
+		if ( indexIt == _eventIndex.end() ) {
+			it = _decoratedEvents.erase(it);
+			continue;
+		}
+
+		auto &entry = _events[indexIt->second];
+		auto origin = entry.symbol.origin;
+
+		if ( !(entry.flags & Decorated) ) {
+			it = _decoratedEvents.erase(it);
+		}
+		else if ( static_cast<WavefrontDecorator*>(origin->decorator())->isExpired() ) {
+			origin->setDecorator(nullptr);
+			entry.flags &= ~Decorated;
+			it = _decoratedEvents.erase(it);
+		}
+		else {
+			hasActiveDecorators = true;
+			++it;
 		}
 	}
 
@@ -475,9 +699,10 @@ void EventLayer::setHoverId(const std::string &id) {
 	bool updateRequired = false;
 
 	if ( !_hoverId.empty() ) {
-		auto it = _eventSymbols.find(_hoverId);
-		if ( it != _eventSymbols.end() ) {
-			it.value().origin->setDepth(it.value().origin->depth());
+		auto it = _eventIndex.find(_hoverId);
+		if ( it != _eventIndex.end() ) {
+			auto origin = _events[it->second].symbol.origin;
+			origin->setDepth(origin->depth());
 			updateRequired = true;
 		}
 	}
@@ -485,10 +710,11 @@ void EventLayer::setHoverId(const std::string &id) {
 	_hoverId = id;
 
 	if ( !_hoverId.empty() ) {
-		auto it = _eventSymbols.find(_hoverId);
-		if ( it != _eventSymbols.end() ) {
-			it.value().origin->setFillColor(it.value().origin->color());
-			it.value().origin->setColor(QColor(33,53,81));
+		auto it = _eventIndex.find(_hoverId);
+		if ( it != _eventIndex.end() ) {
+			auto origin = _events[it->second].symbol.origin;
+			origin->setFillColor(origin->color());
+			origin->setColor(QColor(33,53,81));
 			updateRequired = true;
 		}
 	}
@@ -502,6 +728,49 @@ void EventLayer::setHoverId(const std::string &id) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void EventLayer::updateScreenIndex() {
+	EventScreenIndex::Items items;
+	int radius = 0;
+
+	items.reserve(_events.size());
+
+	for ( const auto &entry : _events ) {
+		const auto origin = entry.symbol.origin;
+		if ( !(entry.flags & Clipped) && origin->isVisible() ) {
+			radius = std::max(radius, std::max(origin->size().width(), origin->size().height()) / 2 + 1);
+		}
+	}
+
+	// Not every projection clips symbols outside the viewport. Symbols
+	// that cannot reach the canvas are left out, otherwise they would be
+	// clamped into the border cells and count against their limit.
+	QRect area = QRect(QPoint(), _canvasSize).adjusted(-radius, -radius, radius, radius);
+
+	for ( int i = 0; i < static_cast<int>(_events.size()); ++i ) {
+		const auto &entry = _events[i];
+		const auto origin = entry.symbol.origin;
+
+		if ( (entry.flags & Clipped) || !origin->isVisible()
+		  || !area.contains(origin->pos()) ) {
+			continue;
+		}
+
+		items.push_back({origin->pos(), entry.magnitude, i, 0});
+	}
+
+	// Thin out only at low zoom, zoomed in all events can be hovered
+	int maxPerCell = _pixelPerDegree < _thinningScale
+	               ? MaxEventsPerCell : std::numeric_limits<int>::max();
+
+	_screenIndex.build(_canvasSize, items, maxPerCell, radius);
+	_screenIndexDirty = false;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -29,6 +29,13 @@
 #endif
 
 #include <QMap>
+#include <QSize>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "eventindex.h"
 
 
 namespace Seiscomp::MapViewX {
@@ -38,11 +45,36 @@ class EventLayer : public Gui::EventLayer {
 	Q_OBJECT
 
 
+	// ----------------------------------------------------------------------
+	//  Public types
+	// ----------------------------------------------------------------------
+	public:
+		enum EventFlag {
+			//! The origin symbol carries a travel time decorator
+			Decorated = 0x01,
+			//! The origin symbol is outside the visible map area
+			Clipped   = 0x02
+		};
+
+		//! The symbols and the display attributes of an event
+		struct EventEntry {
+			std::string  id;
+			EventSymbol  symbol;
+			//! The location as (lon, lat)
+			QPointF      location;
+			float        magnitude{0};
+			float        depth{0};
+			Core::Time   time;
+			quint8       flags{0};
+		};
+
+
 	// ----------------------------------------------------------------------
 	//  X'truction
 	// ----------------------------------------------------------------------
 	public:
 		EventLayer(QObject* parent, DataModel::PublicObjectCache *cache);
+		~EventLayer() override;
 
 
 	// ----------------------------------------------------------------------
@@ -59,12 +91,27 @@ class EventLayer : public Gui::EventLayer {
 		void setCurrentEvent(DataModel::Event *evt);
 		int eventCount() const;
 
+		/**
+		 * @brief Adds many events at once, e.g. when loading a catalog.
+		 *        The symbols are projected in a single pass and one
+		 *        update is requested at the end.
+		 */
+		void addEvents(const std::vector<DataModel::Event*> &events);
+
+		/**
+		 * @brief Sets the scale below which crowded event symbols are
+		 *        thinned out. Zoomed in further, all events are shown.
+		 * @param pixelPerDegree The scale or 0 to disable thinning
+		 */
+		void setThinningScale(double pixelPerDegree);
+
 
 	// ----------------------------------------------------------------------
 	//  Layer interface
 	// ----------------------------------------------------------------------
 	public:
 		void draw(const Gui::Map::Canvas *, QPainter &) override;
+		void calculateMapPosition(const Gui::Map::Canvas *canvas) override;
 		bool isInside(const QMouseEvent *event, const QPointF &geoPos) override;
 
 		void handleLeaveEvent() override;
@@ -97,14 +144,47 @@ class EventLayer : public Gui::EventLayer {
 	// ----------------------------------------------------------------------
 	private:
 		void setHoverId(const std::string &id);
+		void updateScreenIndex();
+
+		/**
+		 * @brief Projects the symbols of the events in [first, last).
+		 */
+		void calculateMapPosition(const Gui::Map::Canvas *canvas, int first, int last);
+
+		/**
+		 * @brief Creates or updates the symbols of an event.
+		 * @param canvas The canvas to project the symbols with or nullptr
+		 *               to leave the projection to the caller
+		 * @return Whether the preferred origin has been found
+		 */
+		bool storeEvent(DataModel::Event *e, Gui::Map::Canvas *canvas);
 
 
 	// ----------------------------------------------------------------------
 	//  Protected members
 	// ----------------------------------------------------------------------
 	protected:
+		using Events = std::vector<EventEntry>;
+		using EventIndex = std::unordered_map<std::string, int>;
+
 		Gui::OriginSymbol            *_currentEvent;
+		std::string                   _currentEventId;
 		DataModel::PublicObjectCache *_cache;
+		//! The events in a dense array, the symbol map of the base class
+		//! is not used
+		Events                        _events;
+		//! Maps public IDs to indexes into _events
+		EventIndex                    _eventIndex;
+		//! The IDs of the events with a travel time decorator. Only
+		//! recent events carry a decorator, it is removed when it has
+		//! expired.
+		std::vector<std::string>      _decoratedEvents;
+		//! The visible and thinned out events, rebuilt on demand
+		EventScreenIndex              _screenIndex;
+		bool                          _screenIndexDirty{true};
+		QSize                         _canvasSize;
+		double                        _pixelPerDegree{0};
+		double                        _thinningScale{50};
 };
 
 
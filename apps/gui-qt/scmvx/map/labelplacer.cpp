@@ -0,0 +1,115 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+
+#include "labelplacer.h"
+
+
+namespace Seiscomp::MapViewX {
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void LabelPlacer::reset(const QSize &area) {
+	_columns = qMax(1, (area.width() + CellSize - 1) / CellSize);
+	_rows = qMax(1, (area.height() + CellSize - 1) / CellSize);
+
+	_cells.resize(_columns * _rows);
+	for ( auto &cell : _cells ) {
+		cell.clear();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+int LabelPlacer::place(const QRect *candidates, int count) {
+	for ( int i = 0; i < count; ++i ) {
+		if ( !overlaps(candidates[i]) ) {
+			insert(candidates[i]);
+			return i;
+		}
+	}
+
+	return -1;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool LabelPlacer::overlaps(const QRect &rect) const {
+	QRect range = cellRange(rect);
+
+	for ( int y = range.top(); y <= range.bottom(); ++y ) {
+		for ( int x = range.left(); x <= range.right(); ++x ) {
+			for ( const QRect &placed : _cells[y * _columns + x] ) {
+				if ( placed.intersects(rect) ) {
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void LabelPlacer::insert(const QRect &rect) {
+	QRect range = cellRange(rect);
+
+	for ( int y = range.top(); y <= range.bottom(); ++y ) {
+		for ( int x = range.left(); x <= range.right(); ++x ) {
+			_cells[y * _columns + x].push_back(rect);
+		}
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+QRect LabelPlacer::cellRange(const QRect &rect) const {
+	// Labels reaching out of the area are registered in the border cells
+	auto column = [this](int x) {
+		return qBound(0, (x < 0 ? -1 : x / CellSize), _columns - 1);
+	};
+	auto row = [this](int y) {
+		return qBound(0, (y < 0 ? -1 : y / CellSize), _rows - 1);
+	};
+
+	return QRect(QPoint(column(rect.left()), row(rect.top())),
+	             QPoint(column(rect.right()), row(rect.bottom())));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -0,0 +1,88 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+#ifndef SEISCOMP_MAPVIEWX_LABELPLACER_H
+#define SEISCOMP_MAPVIEWX_LABELPLACER_H
+
+
+#include <QRect>
+#include <QSize>
+
+#include <vector>
+
+
+namespace Seiscomp::MapViewX {
+
+
+/**
+ * @brief Greedy placement of non-overlapping labels.
+ *
+ * Labels are placed one after another in order of their importance. Each
+ * label offers a list of candidate rectangles and the first one which does
+ * not overlap an already placed label is taken. Placed rectangles are
+ * registered in a uniform grid so that a test only checks the labels of
+ * the covered cells.
+ */
+class LabelPlacer {
+	// ----------------------------------------------------------------------
+	//  Public interface
+	// ----------------------------------------------------------------------
+	public:
+		/**
+		 * @brief Removes all placed labels and sets up the grid for the
+		 *        given screen area.
+		 */
+		void reset(const QSize &area);
+
+		/**
+		 * @brief Places a label at the first candidate which does not
+		 *        overlap any placed label.
+		 * @param candidates The candidate rectangles in order of preference
+		 * @param count The number of candidates
+		 * @return The index of the chosen candidate or -1 if all overlap
+		 */
+		int place(const QRect *candidates, int count);
+
+
+	// ----------------------------------------------------------------------
+	//  Private methods
+	// ----------------------------------------------------------------------
+	private:
+		bool overlaps(const QRect &rect) const;
+		void insert(const QRect &rect);
+		QRect cellRange(const QRect &rect) const;
+
+
+	// ----------------------------------------------------------------------
+	//  Private members
+	// ----------------------------------------------------------------------
+	private:
+		static const int CellSize = 64;
+
+		int                             _columns{0};
+		int                             _rows{0};
+		std::vector<std::vector<QRect>> _cells;
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,99 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+#ifndef SEISCOMP_MAPVIEWX_LEGENDCACHE_H
+#define SEISCOMP_MAPVIEWX_LEGENDCACHE_H
+
+
+#include <QFont>
+#include <QGuiApplication>
+#include <QPainter>
+#include <QPalette>
+#include <QPixmap>
+
+
+namespace Seiscomp::MapViewX {
+
+
+/**
+ * @brief Caches the rendered content of a legend in a pixmap.
+ *
+ * The content is rendered again if the cache has been invalidated, e.g.
+ * after the items of the legend have changed, or if the size, the device
+ * pixel ratio, the pen or the font of the target painter or the
+ * application palette differ from the cached state. Otherwise drawing the
+ * legend is a single blit.
+ */
+class LegendCache {
+	public:
+		void invalidate() { _valid = false; }
+
+		/**
+		 * @brief Draws the cached content into rect.
+		 * @param rect The target rectangle
+		 * @param painter The target painter
+		 * @param render Called as render(const QRect &, QPainter &) to
+		 *               render the content if the cache is outdated
+		 */
+		template <typename F>
+		void draw(const QRect &rect, QPainter &painter, F render) {
+			qreal dpr = painter.device()->devicePixelRatioF();
+			qint64 paletteKey = QGuiApplication::palette().cacheKey();
+
+			if ( !_valid || (_size != rect.size()) || (_dpr != dpr)
+			  || (_pen != painter.pen()) || (_font != painter.font())
+			  || (_paletteKey != paletteKey) ) {
+				_size = rect.size();
+				_dpr = dpr;
+				_pen = painter.pen();
+				_font = painter.font();
+				_paletteKey = paletteKey;
+
+				_pixmap = QPixmap(_size * _dpr);
+				_pixmap.setDevicePixelRatio(_dpr);
+				_pixmap.fill(Qt::transparent);
+
+				QPainter p(&_pixmap);
+				p.setRenderHints(painter.renderHints());
+				p.setPen(_pen);
+				p.setFont(_font);
+				render(QRect(QPoint(0, 0), _size), p);
+
+				_valid = true;
+			}
+
+			painter.drawPixmap(rect.topLeft(), _pixmap);
+		}
+
+	private:
+		QPixmap _pixmap;
+		QSize   _size;
+		qreal   _dpr{0};
+		QPen    _pen;
+		QFont   _font;
+		qint64  _paletteKey{0};
+		bool    _valid{false};
+};
+
+
+}
+
+
+#endif
@@ -23,9 +23,15 @@
 #include <seiscomp/gui/core/icon.h>
 #include <seiscomp/gui/map/canvas.h>
 
+#include <QtMath>
+
 #include <algorithm>
+#include <cmath>
+#include <set>
 
+#include "batchprojection.h"
 #include "networklayer.h"
+#include "parallel.h"
 #include "settings.h"
 
 
@@ -53,31 +59,114 @@ typedef QVector<Row> Grid;
 #define goldenRationConjugate 0.618033988749895
 
 
+// The store slots are sorted top to bottom
 bool topToBottom(const NetworkLayerSymbol *s1, const NetworkLayerSymbol *s2) {
-	return s1->latitude() > s2->latitude();
+	return s1->index() < s2->index();
+}
+
+
+QSize layoutSize(const QImage &image) {
+	return QSize(
+		qCeil(image.width() / image.devicePixelRatio()),
+		qCeil(image.height() / image.devicePixelRatio())
+	);
+}
+
+
+int warningSymbolPenWidth(const QImage &icon) {
+	QSize size = layoutSize(icon);
+	return qMax(2, qMax(size.width(), size.height()) / 5);
 }
 
 
-void drawWarningSymbol(QPainter &painter, const QPoint &lowerLeft, const QPixmap &pixmap) {
+void drawWarningSymbol(QPainter &painter, const QPoint &center, int radius,
+                       const QImage &icon) {
 	static QColor errorBorder(192, 0, 0);
-	QSize layoutSize = pixmap.size() / pixmap.devicePixelRatio();
-	int size = qMax(layoutSize.width(), layoutSize.height());
-	int radius = size * 75 / 100;
-	QPoint center = lowerLeft + QPoint(radius, -radius);
-	painter.setPen(QPen(errorBorder, qMax(2, size / 5)));
+	QSize size = layoutSize(icon);
+	painter.setPen(QPen(errorBorder, warningSymbolPenWidth(icon)));
 	painter.setBrush(Qt::white);
 	painter.drawEllipse(center, radius, radius);
-	painter.drawPixmap(
-		center.x() - layoutSize.width() / 2,
-		center.y() - layoutSize.height() / 2,
-		pixmap
+	painter.drawImage(
+		center.x() - size.width() / 2,
+		center.y() - size.height() / 2,
+		icon
 	);
 }
 
 
-NetworkLayerGradient *currentGradient = nullptr;
+const int RasterTileSize = 256;
+//! The space between a label text and its frame in pixels
+const int LabelPadding = 2;
+
+
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayerGradient::compile() {
+	_stopValues.clear();
+	_stopColors.clear();
+	_lut.clear();
+
+	for ( auto it = begin(); it != end(); ++it ) {
+		_stopValues.push_back(it.key());
+		_stopColors.push_back(it.value().first.rgba());
+	}
+
+	if ( _stopValues.size() < 2 ) {
+		return;
+	}
+
+	_lutScale = (LUTSize - 1) / lutPosition(_stopValues.back());
+	_lut.assign(LUTSize, 0);
+
+	// Each stop is the last stop before all bins following the bin it
+	// falls into. Values within that bin are resolved in rgbAt.
+	for ( size_t i = 1; i < _stopValues.size(); ++i ) {
+		int bin = static_cast<int>(lutPosition(_stopValues[i]) * _lutScale);
+		for ( int b = bin + 1; b < LUTSize; ++b ) {
+			_lut[b] = static_cast<quint16>(i);
+		}
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+QRgb NetworkLayerGradient::rgbAt(double value) const {
+	if ( _stopColors.empty() ) {
+		return qRgb(0, 0, 0);
+	}
+
+	if ( !(value > _stopValues.front()) ) {
+		return _stopColors.front();
+	}
+
+	if ( value >= _stopValues.back() ) {
+		return _stopColors.back();
+	}
+
+	size_t idx = _lut[static_cast<int>(lutPosition(value) * _lutScale)];
+	while ( idx + 1 < _stopValues.size() && value >= _stopValues[idx + 1] ) {
+		++idx;
+	}
+
+	return _stopColors[idx];
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+double NetworkLayerGradient::lutPosition(double value) const {
+	double offset = value - _stopValues.front();
+	return logScale ? std::log1p(offset) : offset;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -85,15 +174,18 @@ NetworkLayerGradient *currentGradient = nullptr;
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-NetworkLayerSymbol::NetworkLayerSymbol(NetworkLayer *layer,
-                                       DataModel::Station *station,
-                                       Gui::Map::AnnotationItem *annotation)
-: _annotation(annotation)
-, _model(station)
+NetworkLayerSymbol::NetworkLayerSymbol(NetworkLayer *layer, int index,
+                                       DataModel::Station *station)
+: _model(station)
+, _data(nullptr)
 , _selected(false)
-, _value(-1)
 , _layer(layer)
-, _state(Settings::OK) {
+, _index(index) {
+	store().symbols[_index] = this;
+
+	_label.setTextFormat(Qt::PlainText);
+	_label.setPerformanceHint(QStaticText::AggressiveCaching);
+
 	setDefaultVisibility();
 	setColor(defaultColor);
 	setPen(defaultFrameColor);
@@ -102,15 +194,8 @@ NetworkLayerSymbol::NetworkLayerSymbol(NetworkLayer *layer,
 	if ( it != global.stationConfig.end() ) {
 		_data = it->second.get();
 	}
-}
-// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
-
-
-
 
-// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-NetworkLayerSymbol::~NetworkLayerSymbol() {
-	delete _annotation;
+	buildLabels();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -126,6 +211,43 @@ void NetworkLayerSymbol::setDefaultVisibility() {
 	catch ( ... ) {
 		setVisible(false);
 	}
+
+	store().setFlag(_index, StationSymbolStore::Visible, isVisible());
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayerSymbol::setAnnotation(const QString &a) {
+	if ( _label.text() == a ) {
+		return;
+	}
+
+	_label.setText(a);
+	_labelExtent = QRect();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayerSymbol::buildLabels() {
+	_stationLabel = QString("%1.%2")
+	                .arg(_model->network()->code().c_str())
+	                .arg(_model->code().c_str());
+
+	if ( _data && _data->channel ) {
+		_channelLabel = QString("%1.%2.%3")
+		                .arg(_stationLabel)
+		                .arg(_data->channel->sensorLocation()->code().c_str())
+		                .arg(_data->channel->code().c_str());
+	}
+	else {
+		_channelLabel = _stationLabel;
+	}
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -137,6 +259,9 @@ bool NetworkLayerSymbol::setSelected(bool f) {
 	if ( _selected == f ) return false;
 	_selected = f;
 	setPen(_selected ? selectedFrameColor : defaultFrameColor);
+	if ( _layer ) {
+		_layer->symbolChanged(this);
+	}
 	return true;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -146,8 +271,16 @@ bool NetworkLayerSymbol::setSelected(bool f) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void NetworkLayerSymbol::setColor(QColor c) {
-	_color = c;
-	setFill(_color);
+	// Unchanged colors must not trigger a rebuild of the static layer
+	if ( store().color[_index] == c.rgba() ) {
+		return;
+	}
+
+	store().color[_index] = c.rgba();
+
+	if ( _layer ) {
+		_layer->symbolChanged(this);
+	}
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -166,11 +299,14 @@ void NetworkLayerSymbol::setColorFromValue(double value) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void NetworkLayerSymbol::updateColor() {
-	if ( _value < 0 ) {
-		setColor(currentGradient ? currentGradient->unsetColor : QColor(0,0,0,128));
+	const NetworkLayerGradient *gradient = _layer ? _layer->activeGradient() : nullptr;
+	double v = value();
+
+	if ( v < 0 ) {
+		setColor(gradient ? gradient->unsetColor : QColor(0,0,0,128));
 	}
-	else if ( currentGradient ) {
-		setColor(currentGradient->colorAt(_value, true));
+	else if ( gradient ) {
+		setColor(QColor::fromRgba(gradient->rgbAt(v)));
 	}
 	else {
 		setColor(Qt::white);
@@ -184,8 +320,14 @@ void NetworkLayerSymbol::updateColor() {
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void NetworkLayerSymbol::calculateMapPosition(const Seiscomp::Gui::Map::Canvas *canvas) {
 	StationSymbol::calculateMapPosition(canvas);
-	if ( _annotation ) {
-		_annotation->visible = !isClipped() && isVisible();
+
+	auto &s = store();
+	s.x[_index] = _position.x();
+	s.y[_index] = _position.y();
+	s.setFlag(_index, StationSymbolStore::Clipped, isClipped());
+
+	if ( _layer ) {
+		_layer->invalidateLabels();
 	}
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -194,12 +336,10 @@ void NetworkLayerSymbol::calculateMapPosition(const Seiscomp::Gui::Map::Canvas *
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-void NetworkLayerSymbol::customDraw(const Gui::Map::Canvas *canvas, QPainter &painter) {
-	StationSymbol::customDraw(canvas, painter);
-
-	if ( _annotation && _annotation->visible ) {
-		_annotation->updateLabelRect(painter, _position - QPoint(0, width() + painter.fontMetrics().height() / 2));
-	}
+void NetworkLayerSymbol::syncMapPosition() {
+	const auto &s = store();
+	_position = QPoint(s.x[_index], s.y[_index]);
+	_clipped = s.testFlag(_index, StationSymbolStore::Clipped);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -227,6 +367,17 @@ void NetworkLayerLegend::contextResizeEvent(const QSize &size) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void NetworkLayerLegend::draw(const QRect &rect, QPainter &painter) {
+	_cache.draw(rect, painter, [this](const QRect &r, QPainter &p) {
+		drawContent(r, p);
+	});
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayerLegend::drawContent(const QRect &rect, QPainter &painter) {
 	int fontHeight = QFontMetricsF(qApp->font()).height();
 	int w = rect.width();
 	int x = rect.left() + fontHeight/2;
@@ -271,7 +422,7 @@ void NetworkLayerLegend::updateFrom(NetworkLayer *layer) {
 				_items.append(QPair<QString, QColor>(it->first.c_str(), it->second));
 
 			_maxColumns = 6;
-			updateLayout();
+			itemsChanged();
 
 			setEnabled(true);
 			break;
@@ -300,7 +451,7 @@ void NetworkLayerLegend::updateFrom(NetworkLayer *layer) {
 			}
 
 			_maxColumns = 1;
-			updateLayout();
+			itemsChanged();
 
 			setEnabled(true);
 			break;
@@ -340,7 +491,7 @@ void NetworkLayerLegend::updateFrom(NetworkLayer *layer) {
 				}
 
 				_maxColumns = 1;
-				updateLayout();
+				itemsChanged();
 
 				setEnabled(true);
 				break;
@@ -352,6 +503,7 @@ void NetworkLayerLegend::updateFrom(NetworkLayer *layer) {
 			setTitle(QString());
 			setEnabled(false);
 			_items.clear();
+			_cache.invalidate();
 			break;
 	}
 }
@@ -360,6 +512,25 @@ void NetworkLayerLegend::updateFrom(NetworkLayer *layer) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayerLegend::itemsChanged() {
+	QFontMetricsF fm(qApp->font());
+
+	_itemWidth = 0;
+	for ( int i = 0; i < _items.count(); ++i ) {
+		int itemWidth = QT_FM_WIDTH(fm, _items[i].first);
+		if ( itemWidth > _itemWidth )
+			_itemWidth = itemWidth;
+	}
+
+	updateLayout();
+	_cache.invalidate();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void NetworkLayerLegend::updateLayout() {
 	QSize size = layer()->size();
@@ -370,13 +541,7 @@ void NetworkLayerLegend::updateLayout() {
 	int fontHeight = QFontMetricsF(qApp->font()).height();
 
 	_columns = 1;
-
-	_columnWidth = 0;
-	for ( int i = 0; i < _items.count(); ++i ) {
-		int itemWidth = QT_FM_WIDTH(QFontMetricsF(qApp->font()), _items[i].first);
-		if ( itemWidth > _columnWidth )
-			_columnWidth = itemWidth;
-	}
+	_columnWidth = _itemWidth;
 
 	_size.setWidth((_columnWidth + fontHeight*3/2)*_columns + fontHeight + fontHeight/2*(_columns-1));
 	_size.setHeight(qMax(((_items.count()+_columns-1)/_columns)*fontHeight*3/2+fontHeight/2, 0));
@@ -405,6 +570,9 @@ NetworkLayer::NetworkLayer(QObject *parent)
 	setName("stations");
 	_activeQCParameter = "delay";
 
+	_expiryTimer.setSingleShot(true);
+	connect(&_expiryTimer, SIGNAL(timeout()), this, SLOT(expireTriggers()));
+
 	_gmGradient.title = "PGV in nm/s";
 	_gmGradient.unsetColor = SCScheme.colors.gm.gmNotSet;
 	_gmGradient.setColorAt(0, SCScheme.colors.gm.gm0);
@@ -439,6 +607,7 @@ NetworkLayer::NetworkLayer(QObject *parent)
 	g = &_qcGradients["timing quality"];
 	g->title = "Timing Quality";
 	g->unsetColor = SCScheme.colors.qc.qcNotSet;
+	g->higherIsWorse = false;
 	g->setColorAt(0, SCScheme.colors.qc.qcWarning, "Warning < 50");
 	g->setColorAt(50, SCScheme.colors.qc.qcOk, "OK >= 50");
 
@@ -459,6 +628,7 @@ NetworkLayer::NetworkLayer(QObject *parent)
 
 	g = &_qcGradients["availability"];
 	g->title = "Availability";
+	g->higherIsWorse = false;
 	g->setColorAt(0, SCScheme.colors.qc.qcError, "Error");
 	g->setColorAt(75, SCScheme.colors.qc.qcWarning, "Warning");
 	g->setColorAt(100, SCScheme.colors.qc.qcOk, "OK");
@@ -470,9 +640,19 @@ NetworkLayer::NetworkLayer(QObject *parent)
 
 	g = &_qcGradients["rms"];
 	g->title = "RMS";
+	g->higherIsWorse = false;
 	g->setColorAt(0, SCScheme.colors.qc.qcError, "Error");
 	g->setColorAt(10, SCScheme.colors.qc.qcOk, "OK");
 
+	// PGV spans several orders of magnitude
+	_gmGradient.logScale = true;
+	_gmGradient.compile();
+	for ( auto &gradient : _qcGradients ) {
+		gradient.compile();
+	}
+
+	updateActiveGradient();
+
 	_legend = new NetworkLayerLegend(this);
 	_legend->setEnabled(true);
 	_legend->setArea(Qt::AlignRight | Qt::AlignTop);
@@ -495,25 +675,11 @@ NetworkLayer::~NetworkLayer() {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void NetworkLayer::updateAnnotations() {
-	foreach ( NetworkLayerSymbol *s, _stationSymbols ) {
-		DataModel::Station *sta = s->model();
-		if ( _showChannelCodes && s->data()->channel ) {
-			s->setAnnotation(
-				(
-					sta->network()->code() + "." + sta->code() + "." +
-					s->data()->channel->sensorLocation()->code() + "." +
-					s->data()->channel->code()
-				).c_str()
-			);
-		}
-		else {
-			s->setAnnotation(
-				(
-					sta->network()->code() + "." + sta->code()
-				).c_str()
-			);
-		}
+	for ( NetworkLayerSymbol *s : _store.symbols ) {
+		s->setAnnotation(_showChannelCodes ? s->_channelLabel : s->_stationLabel);
 	}
+
+	invalidateLabels();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -522,11 +688,21 @@ void NetworkLayer::updateAnnotations() {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void NetworkLayer::disposeSymbols() {
-	foreach ( NetworkLayerSymbol *s, _stationSymbols )
+	for ( NetworkLayerSymbol *s : _store.symbols )
 		delete s;
 
-	_stationSymbols.clear();
+	_store.clear();
 	_stationSymbolLookup.clear();
+	invalidateBuckets();
+	_clusterIndex.clear();
+	_clusterIndexDirty = true;
+	_clusterLevel = -1;
+	invalidateStaticLayer();
+	invalidateLabels();
+	_labels.clear();
+	_triggeredSymbols.clear();
+	_triggerExpiries = TriggerExpiries();
+	_expiryTimer.stop();
 	_currentSymbol = nullptr;
 	_currentClickSymbol = nullptr;
 
@@ -547,11 +723,17 @@ void NetworkLayer::setColorMode(ColorMode mode, bool force) {
 	}
 
 	_colorMode = mode;
+	updateActiveGradient();
+	// The order of the labels depends on the significance of the values
+	invalidateLabels();
 
-	foreach ( NetworkLayerSymbol *s, _stationSymbols ) {
+	for ( NetworkLayerSymbol *s : _store.symbols ) {
 		updateColor(s);
 	}
 
+	_clusterIndex.invalidate();
+	invalidateStaticLayer();
+
 	_legend->updateFrom(this);
 
 	emit updateRequested();
@@ -563,7 +745,6 @@ void NetworkLayer::setColorMode(ColorMode mode, bool force) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void NetworkLayer::setInventory(DataModel::Inventory *inv,
-                                Gui::Map::Annotations *annotations,
                                 const Core::Time *time) {
 	disposeSymbols();
 
@@ -581,6 +762,16 @@ void NetworkLayer::setInventory(DataModel::Inventory *inv,
 		refTime = Core::Time::UTC();
 	}
 
+	struct Candidate {
+		DataModel::Station *station;
+		double              latitude;
+		double              longitude;
+		std::string         id;
+	};
+
+	std::vector<Candidate> candidates;
+	std::set<std::string> ids;
+
 	for ( n = 0; n < inv->networkCount(); ++n ) {
 		DataModel::Network *net = inv->network(n);
 
@@ -608,32 +799,48 @@ void NetworkLayer::setInventory(DataModel::Inventory *inv,
 			}
 
 			auto staID = net->code() + "." + sta->code();
-			if ( _stationSymbolLookup.find(staID) != _stationSymbolLookup.end() ) {
+			if ( !ids.insert(staID).second ) {
 				// Symbol with ID already registered
 				continue;
 			}
 
 			// Got a valid station epoch
-			NetworkLayerSymbol *symbol = new NetworkLayerSymbol(this, sta, annotations->add(QString()));
-			symbol->setPenWidth(defaultFrameWidth);
-			symbol->setLocation(lat, lon);
-			updateColor(symbol);
-
-			_stationSymbolLookup[staID] = symbol;
-			_stationSymbols.append(symbol);
-
-			// Register symbol with config
-			auto it = global.stationConfig.find(symbol->model());
-			if ( it != global.stationConfig.end() ) {
-				auto data = it->second.get();
-				data->viewData = symbol;
-			}
+			candidates.push_back({sta, lat, lon, staID});
+		}
+	}
+
+	// Store slots are allocated top to bottom which is the drawing order
+	std::stable_sort(candidates.begin(), candidates.end(),
+	                 [](const Candidate &c1, const Candidate &c2) {
+		return c1.latitude > c2.latitude;
+	});
+
+	_store.reserve(static_cast<int>(candidates.size()));
+
+	for ( const auto &candidate : candidates ) {
+		int index = _store.append(candidate.latitude, candidate.longitude);
+		NetworkLayerSymbol *symbol = new NetworkLayerSymbol(this, index, candidate.station);
+		symbol->setPenWidth(defaultFrameWidth);
+		symbol->setLocation(candidate.latitude, candidate.longitude);
+		updateColor(symbol);
+
+		_stationSymbolLookup[candidate.id] = symbol;
+
+		// Register symbol with config
+		auto it = global.stationConfig.find(symbol->model());
+		if ( it != global.stationConfig.end() ) {
+			auto data = it->second.get();
+			data->viewData = symbol;
+			activateTrigger(symbol);
 		}
 	}
 
+	scheduleExpiry();
+
 	updateAnnotations();
 
-	std::sort(_stationSymbols.begin(), _stationSymbols.end(), topToBottom);
+	invalidateBuckets();
+	_clusterIndexDirty = true;
 	_legend->updateFrom(this);
 
 	emit updateRequested();
@@ -656,6 +863,7 @@ void NetworkLayer::clear() {
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void NetworkLayer::setGMGradient(const NetworkLayerGradient &gradient) {
 	_gmGradient = gradient;
+	_gmGradient.compile();
 
 	if ( _colorMode == GroundMotion ) {
 		setColorMode(GroundMotion, true);
@@ -691,25 +899,22 @@ void NetworkLayer::setActiveQCParameter(const std::string &param) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void NetworkLayer::setStationsVisible(QSet<const DataModel::Station*> *set) {
-	if ( set ) {
-		foreach ( NetworkLayerSymbol *s, _stationSymbols ) {
-			s->setDefaultVisibility();
-			if ( !_showUnbound && (s->state() == Settings::Unconfigured) ) {
-				s->setVisible(false);
-			}
-			if ( !set->contains(s->model()) ) {
-				s->setVisible(false);
-			}
-		}
-	}
-	else {
-		foreach ( NetworkLayerSymbol *s, _stationSymbols ) {
-			s->setDefaultVisibility();
-			if ( !_showUnbound && (s->state() == Settings::Unconfigured) ) {
-				s->setVisible(false);
-			}
+	int count = _store.size();
+
+	for ( int i = 0; i < count; ++i ) {
+		NetworkLayerSymbol *s = _store.symbols[i];
+		bool visible = _showUnbound || (_store.state[i] != Settings::Unconfigured);
+
+		if ( visible && set && !set->contains(s->model()) ) {
+			visible = false;
 		}
+
+		setSymbolVisible(s, visible);
 	}
+
+	invalidateBuckets();
+	_clusterIndex.invalidate();
+	invalidateStaticLayer();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -738,6 +943,7 @@ void NetworkLayer::setShowIssues(bool enable) {
 		return;
 	}
 	_showIssues = enable;
+	invalidateStaticLayer();
 	emit updateRequested();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -752,10 +958,47 @@ void NetworkLayer::setShowUnbound(bool enable) {
 	}
 	_showUnbound = enable;
 
-	foreach ( NetworkLayerSymbol *s, _stationSymbols ) {
-		s->setVisible(_showUnbound || (s->state() != Settings::Unconfigured));
+	int count = _store.size();
+
+	for ( int i = 0; i < count; ++i ) {
+		setSymbolVisible(_store.symbols[i], _showUnbound || (_store.state[i] != Settings::Unconfigured));
+	}
+
+	invalidateBuckets();
+	_clusterIndex.invalidate();
+	invalidateStaticLayer();
+
+	emit updateRequested(Position);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::setShowAnnotations(bool enable) {
+	if ( _showAnnotations == enable ) {
+		return;
+	}
+
+	_showAnnotations = enable;
+	invalidateLabels();
+	emit updateRequested();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::setClusteringEnabled(bool enable) {
+	if ( _clustering == enable ) {
+		return;
 	}
 
+	_clustering = enable;
+	_clusterIndex.invalidate();
+
 	emit updateRequested(Position);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -763,6 +1006,38 @@ void NetworkLayer::setShowUnbound(bool enable) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::setTiledRendering(bool enable) {
+	if ( _tiledRendering == enable ) {
+		return;
+	}
+
+	_tiledRendering = enable;
+	invalidateStaticLayer();
+	emit updateRequested();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::setClusterDistance(int pixels) {
+	if ( _clusterDistance == pixels ) {
+		return;
+	}
+
+	_clusterDistance = qMax(1, pixels);
+
+	if ( _clustering ) {
+		emit updateRequested(Position);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 Gui::Map::Legend *NetworkLayer::mainLegend() const {
 	return _legend;
@@ -788,37 +1063,37 @@ void NetworkLayer::updateStation(const std::string &staID) {
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-void NetworkLayer::tick() {
-	Core::Time now = Core::Time::UTC();
-	bool changed = false;
+void NetworkLayer::updateTrigger(Settings::StationData *data) {
+	if ( !data || !data->viewData ) {
+		return;
+	}
 
-	foreach ( NetworkLayerSymbol *s, _stationSymbols ) {
-		s->setPriority(Gui::Map::Symbol::NONE);
+	activateTrigger(static_cast<NetworkLayerSymbol*>(data->viewData));
+	scheduleExpiry();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
-		if ( !s->_data ) {
-			continue;
-		}
 
-		if ( !s->_data->triggerTime ) {
-			continue;
-		}
 
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::tick() {
+	Core::Time now = Core::Time::UTC();
+	bool changed = false;
+
+	// Expired triggers are removed by expireTriggers
+	for ( NetworkLayerSymbol *s : _triggeredSymbols ) {
 		Core::TimeSpan diff = now - *s->_data->triggerTime;
 
-		if ( diff > global.triggerTimeout ) {
-			// Reset trigger time if outdated
-			s->_data->triggerTime = Core::None;
-			s->setFrameSize(0);
-			changed = true;
-		}
-		else if ( diff < Core::TimeSpan(0,0) ) {
+		if ( diff < Core::TimeSpan(0,0) ) {
+			changed = setSymbolPriority(s, Gui::Map::Symbol::NONE) || changed;
 			if ( s->frameSize() > 0 ) {
 				s->setFrameSize(0);
 				changed = true;
 			}
 		}
 		else {
-			s->setPriority(Gui::Map::Symbol::HIGH);
+			setSymbolPriority(s, Gui::Map::Symbol::HIGH);
 
 			if ( global.tickToggleState ) {
 				// Trigger on
@@ -851,18 +1126,82 @@ void NetworkLayer::tick() {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::expireTriggers() {
+	Core::Time now = Core::Time::UTC();
+	bool changed = false;
+
+	while ( !_triggerExpiries.empty() && (_triggerExpiries.top().time <= now) ) {
+		TriggerExpiry expiry = _triggerExpiries.top();
+		_triggerExpiries.pop();
+
+		auto data = expiry.symbol->_data;
+		if ( !_triggeredSymbols.contains(expiry.symbol) || !data->triggerTime
+		  || (*data->triggerTime + global.triggerTimeout != expiry.time) ) {
+			// Outdated entry, the trigger has been updated in the meantime
+			continue;
+		}
+
+		// Reset trigger time if outdated
+		data->triggerTime = Core::None;
+		resetTrigger(expiry.symbol);
+		changed = true;
+	}
+
+	scheduleExpiry();
+
+	if ( changed ) {
+		emit updateRequested();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool NetworkLayer::isInside(const QMouseEvent *event, const QPointF &geoPos) {
 	int x = event->pos().x();
 	int y = event->pos().y();
-	auto it = _stationSymbols.end();
 	_isInsideSymbol = nullptr;
 
-	while ( it != _stationSymbols.begin() ) {
-		--it;
-		if ( (*it)->isInside(x, y) ) {
-			_isInsideSymbol = *it;
-			return true;
+	if ( _bucketsDirty ) {
+		updateBuckets();
+	}
+
+	if ( _clusterLevel >= 0 ) {
+		// Only triggered symbols and clusters with a single station are
+		// drawn individually
+		for ( auto it = _priorityBuckets[Gui::Map::Symbol::HIGH].rbegin();
+		      it != _priorityBuckets[Gui::Map::Symbol::HIGH].rend(); ++it ) {
+			if ( (*it)->isInside(x, y) ) {
+				_isInsideSymbol = *it;
+				return true;
+			}
+		}
+
+		for ( const auto &cluster : _clusterIndex.clusters(_clusterLevel) ) {
+			if ( (cluster.count == 1) && !cluster.clipped
+			  && cluster.representative->isInside(x, y) ) {
+				_isInsideSymbol = cluster.representative;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Test in reverse drawing order to hit the top most symbol first
+	for ( int i = PriorityCount - 1; i >= 0; --i ) {
+		auto &bucket = _priorityBuckets[i];
+		auto it = bucket.end();
+
+		while ( it != bucket.begin() ) {
+			--it;
+			if ( (*it)->isInside(x, y) ) {
+				_isInsideSymbol = *it;
+				return true;
+			}
 		}
 	}
 
@@ -875,8 +1214,37 @@ bool NetworkLayer::isInside(const QMouseEvent *event, const QPointF &geoPos) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void NetworkLayer::calculateMapPosition(const Gui::Map::Canvas *canvas) {
-	foreach ( NetworkLayerSymbol *s, _stationSymbols )
-		s->calculateMapPosition(canvas);
+	int count = _store.size();
+
+	BatchProjection(canvas).project(_store.x.data(), _store.y.data(),
+	                                _store.flags.data(), StationSymbolStore::Clipped,
+	                                _store.latitude.data(), _store.longitude.data(),
+	                                count);
+
+	for ( NetworkLayerSymbol *s : _store.symbols )
+		s->syncMapPosition();
+
+	invalidateBuckets();
+	invalidateStaticLayer();
+	invalidateLabels();
+
+	_clusterLevel = -1;
+
+	if ( !_clustering || !count ) {
+		return;
+	}
+
+	_clusterLevel = StationClusterIndex::selectLevel(canvas->pixelPerDegree(), _clusterDistance);
+	if ( _clusterLevel < 0 ) {
+		return;
+	}
+
+	if ( _clusterIndexDirty ) {
+		_clusterIndex.build(_store.symbols);
+		_clusterIndexDirty = false;
+	}
+
+	_clusterIndex.calculateMapPosition(_clusterLevel, canvas);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -889,67 +1257,43 @@ void NetworkLayer::draw(const Gui::Map::Canvas *canvas, QPainter &p) {
 
 	bool showIssues = _showIssues && (_colorMode == Network);
 
-	foreach ( NetworkLayerSymbol *s, _stationSymbols ) {
-		if ( s->isClipped() || !s->isVisible() ) {
-			continue;
-		}
+	if ( _bucketsDirty ) {
+		updateBuckets();
+	}
 
-		s->drawShadow(p);
+	if ( showIssues ) {
+		updateIssueIcons(p);
 	}
 
-	for ( int i = Gui::Map::Symbol::NONE; i <= Gui::Map::Symbol::HIGH; ++i ) {
-		foreach ( NetworkLayerSymbol *s, _stationSymbols ) {
-			if ( s->isClipped() || !s->isVisible() || (s->priority() != i) ) {
-				continue;
-			}
+	updateStaticLayer(canvas, p, showIssues);
+	p.drawImage(0, 0, _staticLayer);
 
-			s->draw(canvas, p);
-
-			if ( showIssues && (s->state() != Settings::OK) ) {
-				QPoint lowerLeft = s->pos() + QPoint(0, -s->width() / 2);
-
-				static OPT(QPixmap) pmQuestion, pmWrench, pmUnlink, pmDatabase;
-
-				switch ( s->state() ) {
-					case Settings::Unknown:
-						if ( !pmQuestion ) {
-							pmQuestion = Gui::pixmap(p.fontMetrics(), "question_mark", QColor(Qt::black), p.device()->devicePixelRatioF());
-						}
-						drawWarningSymbol(p, lowerLeft, *pmQuestion);
-						break;
-
-					case Settings::Unconfigured:
-						if ( !pmWrench ) {
-							pmWrench = Gui::pixmap(p.fontMetrics(), "settings", QColor(Qt::black), p.device()->devicePixelRatioF());
-						}
-						drawWarningSymbol(p, lowerLeft, *pmWrench);
-						break;
-
-					case Settings::NoPrimaryStream:
-						if ( !pmUnlink ) {
-							pmUnlink = Gui::pixmap(p.fontMetrics(), "unlink", QColor(Qt::black), p.device()->devicePixelRatioF());
-						}
-						drawWarningSymbol(p, lowerLeft, *pmUnlink);
-						break;
-
-					case Settings::NoChannelGroupMetaData:
-					case Settings::NoVerticalChannelMetaData:
-						if ( !pmDatabase ) {
-							pmDatabase = Gui::pixmap(p.fontMetrics(), "database", QColor(Qt::black), p.device()->devicePixelRatioF());
-						}
-						drawWarningSymbol(p, lowerLeft, *pmDatabase);
-						break;
-
-					default:
-						break;
-				}
-			}
-		}
+	if ( _labelsDirty ) {
+		updateLabels(p);
 	}
 
-	p.restore();
-}
-// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+	// Triggered symbols and the hovered symbol are drawn on top of the
+	// static layer
+	for ( NetworkLayerSymbol *s : _priorityBuckets[Gui::Map::Symbol::HIGH] ) {
+		s->draw(canvas, p);
+
+		if ( showIssues ) {
+			drawIssue(p, s, s->state());
+		}
+	}
+
+	if ( _currentSymbol && (_currentSymbol->priority() != Gui::Map::Symbol::HIGH)
+	  && _currentSymbol->isVisible() && !_currentSymbol->isClipped() ) {
+		_currentSymbol->draw(canvas, p);
+
+		if ( showIssues ) {
+			drawIssue(p, _currentSymbol, _currentSymbol->state());
+		}
+	}
+
+	p.restore();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
 
 
@@ -1054,18 +1398,733 @@ bool NetworkLayer::filterMouseDoubleClickEvent(QMouseEvent *, const QPointF &) {
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-void NetworkLayer::updateColor(NetworkLayerSymbol *symbol) {
-	currentGradient = nullptr;
+void NetworkLayer::invalidateBuckets() {
+	_bucketsDirty = true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::updateBuckets() {
+	for ( auto &bucket : _priorityBuckets ) {
+		bucket.clear();
+	}
+
+	// The store is sorted top to bottom and so will be each bucket
+	int count = _store.size();
+
+	for ( int i = 0; i < count; ++i ) {
+		if ( _store.isDrawable(i) ) {
+			_priorityBuckets[_store.priority[i]].append(_store.symbols[i]);
+		}
+	}
+
+	_bucketsDirty = false;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool NetworkLayer::setSymbolPriority(NetworkLayerSymbol *symbol,
+                                     Gui::Map::Symbol::Priority priority) {
+	if ( symbol->priority() == priority ) {
+		return false;
+	}
+
+	if ( !_bucketsDirty && _store.isDrawable(symbol->index()) ) {
+		auto &from = _priorityBuckets[symbol->priority()];
+		auto range = std::equal_range(from.begin(), from.end(), symbol, topToBottom);
+		auto it = std::find(range.first, range.second, symbol);
+		if ( it != range.second ) {
+			from.erase(it);
+		}
+
+		auto &to = _priorityBuckets[priority];
+		to.insert(std::upper_bound(to.begin(), to.end(), symbol, topToBottom), symbol);
+	}
+
+	symbol->setPriority(priority);
+	_store.priority[symbol->index()] = static_cast<quint8>(priority);
+	// Triggered symbols are labeled first
+	invalidateLabels();
+	// The symbol moves between the static layer and the overlay
+	invalidateStaticLayer();
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::setSymbolVisible(NetworkLayerSymbol *symbol, bool visible) {
+	symbol->setVisible(visible);
+	_store.setFlag(symbol->index(), StationSymbolStore::Visible, visible);
+	invalidateLabels();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::invalidateLabels() {
+	_labelsDirty = true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::updateLabels(QPainter &p) {
+	_labels.clear();
+
+	if ( !_showAnnotations ) {
+		_labelsDirty = false;
+		return;
+	}
+
+	// The shaped texts and the label extents only depend on the text and
+	// the font
+	if ( p.font() != _labelFont ) {
+		_labelFont = p.font();
+		for ( NetworkLayerSymbol *s : _store.symbols ) {
+			s->_labelExtent = QRect();
+		}
+	}
+
+	std::vector<NetworkLayerSymbol*> labels;
+
+	if ( _clusterLevel < 0 ) {
+		int count = _store.size();
+		for ( int i = 0; i < count; ++i ) {
+			if ( _store.isDrawable(i) && !_store.symbols[i]->_label.text().isEmpty() ) {
+				labels.push_back(_store.symbols[i]);
+			}
+		}
+	}
+	else {
+		// Stations aggregated into a cluster are not labeled
+		for ( auto &cluster : _clusterIndex.clusters(_clusterLevel) ) {
+			if ( cluster.dirty ) {
+				updateCluster(cluster);
+			}
+
+			if ( cluster.clipped || (cluster.count != 1) ) {
+				continue;
+			}
+
+			auto s = cluster.representative;
+			if ( !s->isClipped() && !s->_label.text().isEmpty() ) {
+				labels.push_back(s);
+			}
+		}
+	}
+
+	// Triggered stations first, then the most significant values
+	std::sort(labels.begin(), labels.end(),
+	          [this](const NetworkLayerSymbol *a, const NetworkLayerSymbol *b) {
+		if ( a->priority() != b->priority() ) {
+			return a->priority() > b->priority();
+		}
+
+		if ( isMoreSignificant(a, b) ) {
+			return true;
+		}
+
+		if ( isMoreSignificant(b, a) ) {
+			return false;
+		}
+
+		return a->index() < b->index();
+	});
+
+	const int spacing = 2;
+	int fontHeight = p.fontMetrics().height();
+
+	_labelPlacer.reset(size());
+
+	for ( NetworkLayerSymbol *s : labels ) {
+		if ( s->_labelExtent.isNull() ) {
+			s->_label.prepare(QTransform(), _labelFont);
+			QSizeF textSize = s->_label.size();
+			QSize size(qCeil(textSize.width()) + 2 * LabelPadding,
+			           qCeil(textSize.height()) + 2 * LabelPadding);
+			s->_labelExtent = QRect(QPoint(-size.width() / 2, -size.height() / 2), size);
+		}
+
+		QPoint pos = s->pos();
+		int width = s->width();
+		QRect candidates[4];
+
+		// Above the symbol which is the default
+		candidates[0] = s->_labelExtent.translated(pos - QPoint(0, width + fontHeight / 2));
+		// Below the symbol
+		candidates[1] = candidates[0];
+		candidates[1].moveTop(pos.y() + spacing);
+		// Right of the symbol
+		candidates[2] = candidates[0];
+		candidates[2].moveLeft(pos.x() + width + spacing);
+		candidates[2].moveTop(pos.y() - (width + candidates[2].height()) / 2);
+		// Left of the symbol
+		candidates[3] = candidates[2];
+		candidates[3].moveRight(pos.x() - width - spacing);
+
+		int idx = _labelPlacer.place(candidates, 4);
+		if ( idx < 0 ) {
+			continue;
+		}
+
+		_labels.push_back({s, candidates[idx]});
+	}
+
+	// Updating dirty clusters above invalidates the labels again
+	_labelsDirty = false;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::drawLabels(QPainter &p) const {
+	if ( !isVisible() || !_showAnnotations || _labels.empty() ) {
+		return;
+	}
+
+	const auto &colors = SCScheme.colors.map.annotations;
+
+	p.save();
+	// The texts have been shaped with this font
+	p.setFont(_labelFont);
+
+	for ( const auto &label : _labels ) {
+		p.setPen(colors.normalBorder);
+		p.setBrush(colors.normalBackground);
+		p.drawRect(label.rect);
+
+		p.setPen(colors.normalText);
+		p.drawStaticText(label.rect.topLeft() + QPoint(LabelPadding, LabelPadding),
+		                 label.symbol->_label);
+	}
+
+	p.restore();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::updateIssueIcons(QPainter &painter) {
+	qreal dpr = painter.device()->devicePixelRatioF();
+	int fontHeight = painter.fontMetrics().height();
+
+	if ( (_issueIconsDPR == dpr) && (_issueIconsFontHeight == fontHeight) ) {
+		return;
+	}
+
+	// Icons are stored as images to be usable by the tile renderer
+	// threads
+	auto createIcon = [&painter, dpr](const char *name) {
+		return Gui::pixmap(painter.fontMetrics(), name, QColor(Qt::black), dpr).toImage();
+	};
+
+	for ( auto &icon : _issueIcons ) {
+		icon = QImage();
+	}
+
+	_issueIcons[Settings::Unknown] = createIcon("question_mark");
+	_issueIcons[Settings::Unconfigured] = createIcon("settings");
+	_issueIcons[Settings::NoPrimaryStream] = createIcon("unlink");
+	_issueIcons[Settings::NoChannelGroupMetaData] = createIcon("database");
+	_issueIcons[Settings::NoVerticalChannelMetaData] = _issueIcons[Settings::NoChannelGroupMetaData];
+
+	_issueIconsDPR = dpr;
+	_issueIconsFontHeight = fontHeight;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::activateTrigger(NetworkLayerSymbol *symbol) {
+	if ( !symbol->_data || !symbol->_data->triggerTime ) {
+		return;
+	}
+
+	_triggeredSymbols.insert(symbol);
+	_triggerExpiries.push({*symbol->_data->triggerTime + global.triggerTimeout, symbol});
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::resetTrigger(NetworkLayerSymbol *symbol) {
+	_triggeredSymbols.remove(symbol);
+	symbol->setFrameSize(0);
+	setSymbolPriority(symbol, Gui::Map::Symbol::NONE);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::scheduleExpiry() {
+	// Drop outdated entries from the top of the queue
+	while ( !_triggerExpiries.empty() ) {
+		const TriggerExpiry &expiry = _triggerExpiries.top();
+		auto data = expiry.symbol->_data;
+		if ( _triggeredSymbols.contains(expiry.symbol) && data->triggerTime
+		  && (*data->triggerTime + global.triggerTimeout == expiry.time) ) {
+			break;
+		}
+
+		_triggerExpiries.pop();
+	}
+
+	if ( _triggerExpiries.empty() ) {
+		_expiryTimer.stop();
+		return;
+	}
+
+	// Limit the interval to one day to stay within the timer range. An
+	// early timeout just reschedules.
+	double msecs = static_cast<double>(_triggerExpiries.top().time - Core::Time::UTC()) * 1000;
+	_expiryTimer.start(static_cast<int>(qBound(0.0, std::ceil(msecs), 86400000.0)));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::invalidateStaticLayer() {
+	_staticLayerDirty = true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::updateStaticLayer(const Gui::Map::Canvas *canvas,
+                                     QPainter &p, bool showIssues) {
+	qreal dpr = p.device()->devicePixelRatioF();
+	QSize imageSize = size() * dpr;
+
+	if ( !_staticLayerDirty && (_staticLayer.size() == imageSize)
+	  && (_staticLayer.devicePixelRatioF() == dpr) ) {
+		return;
+	}
+
+	if ( _staticLayer.size() != imageSize ) {
+		_staticLayer = QImage(imageSize, QImage::Format_ARGB32_Premultiplied);
+	}
+
+	_staticLayer.setDevicePixelRatio(dpr);
+	_staticLayer.fill(Qt::transparent);
+
+	QPainter painter(&_staticLayer);
+	painter.setRenderHints(p.renderHints());
+	painter.setFont(p.font());
+
+	// The hovered symbol is part of the overlay. Render it with its
+	// regular pen to keep the static layer valid if the hover changes.
+	QColor hoverPen;
+	if ( _currentSymbol ) {
+		hoverPen = _currentSymbol->pen();
+		_currentSymbol->setPen(_currentSymbol->isSelected() ? selectedFrameColor : defaultFrameColor);
+	}
+
+	collectStaticItems(painter, showIssues);
+
+	if ( _currentSymbol ) {
+		_currentSymbol->setPen(hoverPen);
+	}
+
+	if ( _tiledRendering ) {
+		rasterizeTiles(painter);
+	}
+	else {
+		for ( const auto &item : _rasterItems ) {
+			drawItem(painter, item);
+		}
+	}
+
+	_staticLayerDirty = false;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::collectStaticItems(QPainter &p, bool showIssues) {
+	qreal dpr = p.device()->devicePixelRatioF();
+	bool antialiasing = p.testRenderHint(QPainter::Antialiasing);
+
+	_rasterItems.clear();
+
+	_countFont = p.font();
+	_countFont.setBold(true);
+	_countFont.setPointSizeF(_countFont.pointSizeF() * 0.8);
+
+	if ( _clusterLevel < 0 ) {
+		for ( int i = 0; i < Gui::Map::Symbol::HIGH; ++i ) {
+			for ( NetworkLayerSymbol *s : _priorityBuckets[i] ) {
+				addSymbolItems(s, showIssues ? s->state() : Settings::OK, dpr, antialiasing);
+			}
+		}
+
+		return;
+	}
+
+	for ( auto &cluster : _clusterIndex.clusters(_clusterLevel) ) {
+		if ( cluster.clipped ) {
+			continue;
+		}
+
+		if ( cluster.dirty ) {
+			updateCluster(cluster);
+		}
+
+		if ( cluster.count == 1 ) {
+			auto s = cluster.representative;
+			// Triggered symbols are drawn on top of all clusters
+			if ( !s->isClipped() && (s->priority() != Gui::Map::Symbol::HIGH) ) {
+				addSymbolItems(s, showIssues ? s->state() : Settings::OK, dpr, antialiasing);
+			}
+			continue;
+		}
+
+		if ( cluster.count == 0 ) {
+			continue;
+		}
+
+		auto symbol = cluster.symbol.get();
+		addSymbolItems(symbol, Settings::OK, dpr, antialiasing);
+
+		RasterItem item;
+		item.type = RasterItem::Count;
+		item.value = cluster.count;
+		item.color = qGray(symbol->fill().rgb()) > 128 ? Qt::black : Qt::white;
+		// Center the count at the centroid of the default triangle shape
+		item.bounds = QRect(0, 0, symbol->width() * 2, symbol->width());
+		item.bounds.moveCenter(symbol->pos() + QPoint(0, -symbol->width() / 2));
+		_rasterItems.push_back(item);
+
+		if ( showIssues && issueItem(item, symbol, cluster.state) ) {
+			_rasterItems.push_back(item);
+		}
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::addSymbolItems(const StationSymbol *symbol,
+                                  Settings::State state, qreal dpr,
+                                  bool antialiasing) {
+	RasterItem item;
+	QPoint offset;
+
+	auto image = symbol->sprite(offset, dpr, antialiasing);
+	if ( image ) {
+		item.type = RasterItem::Sprite;
+		item.pos = symbol->pos() + offset;
+		// Share the image data, the atlas might be flushed while the
+		// items are still in use
+		item.image = *image;
+		item.bounds = QRect(item.pos, layoutSize(item.image));
+		_rasterItems.push_back(item);
+	}
+
+	if ( issueItem(item, symbol, state) ) {
+		_rasterItems.push_back(item);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool NetworkLayer::issueItem(RasterItem &item, const StationSymbol *symbol,
+                             Settings::State state) const {
+	if ( state == Settings::OK ) {
+		return false;
+	}
+
+	const QImage &icon = _issueIcons[state];
+	if ( icon.isNull() ) {
+		return false;
+	}
+
+	QSize size = layoutSize(icon);
+	int radius = qMax(size.width(), size.height()) * 75 / 100;
+	int extent = radius + warningSymbolPenWidth(icon);
+
+	item.type = RasterItem::Issue;
+	// The lower left corner of the circle bounds is attached to the
+	// symbol center
+	item.pos = symbol->pos() + QPoint(radius, -symbol->width() / 2 - radius);
+	item.value = radius;
+	item.image = icon;
+	item.bounds = QRect(item.pos - QPoint(extent, extent), QSize(extent * 2 + 1, extent * 2 + 1));
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::drawItem(QPainter &p, const RasterItem &item) const {
+	switch ( item.type ) {
+		case RasterItem::Sprite:
+			p.drawImage(item.pos, item.image);
+			break;
+
+		case RasterItem::Issue:
+			drawWarningSymbol(p, item.pos, item.value, item.image);
+			break;
+
+		case RasterItem::Count:
+			p.setFont(_countFont);
+			p.setPen(item.color);
+			p.drawText(item.bounds, Qt::AlignCenter, QString::number(item.value));
+			break;
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::rasterizeTiles(QPainter &painter) {
+	QSize layerSize = size();
+	qreal dpr = painter.device()->devicePixelRatioF();
+	QPainter::RenderHints hints = painter.renderHints();
+	int columns = (layerSize.width() + RasterTileSize - 1) / RasterTileSize;
+	int rows = (layerSize.height() + RasterTileSize - 1) / RasterTileSize;
+	int tileCount = columns * rows;
+
+	if ( tileCount <= 0 ) {
+		return;
+	}
+
+	// Assign items to all tiles they overlap. The indexes are added in
+	// drawing order which keeps the z-order of the sequential renderer.
+	std::vector<std::vector<int>> tileItems(static_cast<size_t>(tileCount));
+	QRect layerRect(QPoint(0, 0), layerSize);
+
+	for ( int i = 0; i < static_cast<int>(_rasterItems.size()); ++i ) {
+		QRect rect = _rasterItems[i].bounds.intersected(layerRect);
+		if ( rect.isEmpty() ) {
+			continue;
+		}
+
+		for ( int ty = rect.top() / RasterTileSize; ty <= rect.bottom() / RasterTileSize; ++ty ) {
+			for ( int tx = rect.left() / RasterTileSize; tx <= rect.right() / RasterTileSize; ++tx ) {
+				tileItems[ty * columns + tx].push_back(i);
+			}
+		}
+	}
+
+	std::vector<QImage> tiles(static_cast<size_t>(tileCount));
+
+	parallelFor(tileCount, [&](int t) {
+		const auto &items = tileItems[t];
+		if ( items.empty() ) {
+			return;
+		}
+
+		QPoint origin((t % columns) * RasterTileSize, (t / columns) * RasterTileSize);
+		QImage tile(QSize(RasterTileSize, RasterTileSize) * dpr, QImage::Format_ARGB32_Premultiplied);
+		tile.setDevicePixelRatio(dpr);
+		tile.fill(Qt::transparent);
+
+		QPainter tilePainter(&tile);
+		tilePainter.setRenderHints(hints);
+		tilePainter.translate(-origin);
+
+		for ( int idx : items ) {
+			drawItem(tilePainter, _rasterItems[idx]);
+		}
+
+		tilePainter.end();
+		tiles[t] = tile;
+	});
 
+	for ( int t = 0; t < tileCount; ++t ) {
+		if ( !tiles[t].isNull() ) {
+			painter.drawImage(QPoint((t % columns) * RasterTileSize, (t / columns) * RasterTileSize), tiles[t]);
+		}
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::symbolChanged(NetworkLayerSymbol *symbol) {
+	if ( _clustering ) {
+		_clusterIndex.invalidate(symbol);
+	}
+
+	invalidateStaticLayer();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool NetworkLayer::isMoreSignificant(const NetworkLayerSymbol *a,
+                                     const NetworkLayerSymbol *b) const {
+	switch ( _colorMode ) {
+		case GroundMotion:
+			return a->value() > b->value();
+
+		case QC:
+		{
+			// Unset values are never more significant
+			if ( a->value() < 0 ) {
+				return false;
+			}
+
+			if ( b->value() < 0 ) {
+				return true;
+			}
+
+			auto gradient = qcGradient();
+			if ( gradient && !gradient->higherIsWorse ) {
+				return a->value() < b->value();
+			}
+
+			return a->value() > b->value();
+		}
+
+		default:
+			return a->state() > b->state();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::updateCluster(StationClusterIndex::Cluster &cluster) {
+	bool uniformColor = true;
+	int previousCount = cluster.count;
+	auto previousRepresentative = cluster.representative;
+
+	cluster.count = 0;
+	cluster.state = Settings::OK;
+	cluster.representative = nullptr;
+
+	for ( auto s : cluster.members ) {
+		if ( !s->isVisible() ) {
+			continue;
+		}
+
+		++cluster.count;
+
+		if ( s->state() > cluster.state ) {
+			cluster.state = s->state();
+		}
+
+		if ( !cluster.representative ) {
+			cluster.representative = s;
+			continue;
+		}
+
+		if ( s->color() != cluster.representative->color() ) {
+			uniformColor = false;
+		}
+
+		if ( isMoreSignificant(s, cluster.representative) ) {
+			cluster.representative = s;
+		}
+	}
+
+	cluster.dirty = false;
+
+	// Only stations which are not aggregated are labeled. Color changes
+	// of the members do not affect the labels.
+	if ( (cluster.count != previousCount)
+	  || (cluster.representative != previousRepresentative) ) {
+		invalidateLabels();
+	}
+
+	if ( cluster.count <= 1 ) {
+		cluster.symbol.reset();
+		return;
+	}
+
+	if ( !cluster.symbol ) {
+		cluster.symbol.reset(new StationSymbol(cluster.location.y(), cluster.location.x()));
+		cluster.symbol->setPen(defaultFrameColor);
+		cluster.symbol->setPenWidth(defaultFrameWidth);
+		if ( canvas() ) {
+			cluster.symbol->calculateMapPosition(canvas());
+		}
+	}
+
+	// Clusters of stations with different network colors are drawn with
+	// the default color
+	cluster.symbol->setFill(
+		(_colorMode == Network) && !uniformColor ?
+		defaultColor : cluster.representative->color()
+	);
+	cluster.symbol->setWidth(
+		cluster.representative->width()
+		+ 2 * static_cast<int>(std::log2(static_cast<double>(cluster.count)))
+	);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::drawIssue(QPainter &p, const StationSymbol *symbol,
+                             Settings::State state) {
+	RasterItem item;
+	if ( issueItem(item, symbol, state) ) {
+		drawItem(p, item);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::updateColor(NetworkLayerSymbol *symbol) {
 	bool enabled = true;
 
-	symbol->setState(Settings::OK);
-	auto it  = global.stationConfig.find(symbol->model());
-	if ( it == global.stationConfig.end() ) {
+	const Settings::StationData *data = symbol->data();
+	if ( !data ) {
 		symbol->setState(Settings::Unknown);
 	}
 	else {
-		const Settings::StationData *data = it->second.get();
 		symbol->setState(data->state);
 		enabled = data->enabled;
 	}
@@ -1094,23 +2153,16 @@ void NetworkLayer::updateColor(NetworkLayerSymbol *symbol) {
 			}
 
 			case GroundMotion:
-			{
-				currentGradient = &_gmGradient;
-
-				auto data = symbol->data();
-				symbol->setColorFromValue(data->maximumAmplitude);
-
+				symbol->setColorFromValue(data ? data->maximumAmplitude : -1);
 				break;
-			}
 
 			case QC:
 			{
-				auto git = _qcGradients.find(_activeQCParameter);
-				if ( git != _qcGradients.end() ) {
-					currentGradient = &git.value();
+				if ( !data ) {
+					symbol->setColorFromValue(-1);
+					break;
 				}
 
-				auto data = symbol->data();
 				auto dit = data->qc.find(_activeQCParameter);
 				if ( dit != data->qc.end() ) {
 					symbol->setColorFromValue(dit->second->value());
@@ -1136,6 +2188,25 @@ void NetworkLayer::updateColor(NetworkLayerSymbol *symbol) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void NetworkLayer::updateActiveGradient() {
+	switch ( _colorMode ) {
+		case GroundMotion:
+			_activeGradient = &_gmGradient;
+			break;
+		case QC:
+			_activeGradient = qcGradient();
+			break;
+		default:
+			_activeGradient = nullptr;
+			break;
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
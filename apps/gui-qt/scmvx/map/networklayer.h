@@ -26,12 +26,20 @@
 #include <seiscomp/datamodel/inventory.h>
 #include <seiscomp/gui/core/gradient.h>
 #include <seiscomp/gui/datamodel/stationsymbol.h>
-#include <seiscomp/gui/map/annotations.h>
 #include <seiscomp/gui/map/layer.h>
 
+#include <QStaticText>
+#include <QTimer>
+
 #include <map>
+#include <queue>
+#include <vector>
 
 #include "../settings.h"
+#include "labelplacer.h"
+#include "legendcache.h"
+#include "stationcluster.h"
+#include "stationstore.h"
 #include "stationsymbol.h"
 #endif
 
@@ -42,28 +50,77 @@ namespace Seiscomp::MapViewX {
 class NetworkLayer;
 
 
+/**
+ * @brief A discrete gradient which is compiled into a lookup table to map
+ *        values to colors in constant time.
+ */
 class NetworkLayerGradient : public Gui::Gradient {
 	public:
 		NetworkLayerGradient() = default;
 
+	public:
+		/**
+		 * @brief Compiles the stops into the lookup table. This must be
+		 *        called after the stops or logScale have changed.
+		 */
+		void compile();
+
+		/**
+		 * @brief Returns the color of the stop with the largest value
+		 *        less or equal than value. Values below the first stop map
+		 *        to the first color.
+		 */
+		QRgb rgbAt(double value) const;
+
+	private:
+		double lutPosition(double value) const;
+
 	public:
 		QString title;
 		QColor  unsetColor;
+		//! Whether higher values indicate a worse state. This defines the
+		//! member which represents a station cluster.
+		bool    higherIsWorse{true};
+		//! Whether the lookup table is indexed logarithmically which gives a
+		//! finer resolution for stops spanning several orders of magnitude
+		bool    logScale{false};
+
+	private:
+		static const int LUTSize = 1024;
+
+		std::vector<double>  _stopValues;
+		std::vector<QRgb>    _stopColors;
+		//! The index of the last stop before each bin
+		std::vector<quint16> _lut;
+		double               _lutScale{0};
 };
 
 
+/**
+ * @brief The map symbol of a station. Its render state is held by the
+ *        StationSymbolStore of the layer, the symbol reads and writes its
+ *        slot.
+ *
+ * Color, value and state exist only in the store, fill() reads the color
+ * from there. Position, clipping, visibility and priority are also read
+ * through the non-virtual accessors of Gui::Map::Symbol, so the symbol
+ * keeps a copy of them. Each write goes to both copies: the batched
+ * passes (projection, culling, bucket sorting) read the store, drawing a
+ * single symbol reads the copy in the symbol.
+ */
 class NetworkLayerSymbol : public StationSymbol {
 	public:
-		explicit NetworkLayerSymbol(NetworkLayer *layer,
-		                            DataModel::Station *station,
-		                            Gui::Map::AnnotationItem *annotation);
-		virtual ~NetworkLayerSymbol() override;
+		explicit NetworkLayerSymbol(NetworkLayer *layer, int index,
+		                            DataModel::Station *station);
 
 
 	public:
 		DataModel::Station *model() const { return _model; }
 		Settings::StationData *data() const { return _data; }
 
+		//! Returns the slot index in the store of the layer
+		int index() const { return _index; }
+
 		void setDefaultVisibility();
 
 		bool setSelected(bool);
@@ -71,32 +128,46 @@ class NetworkLayerSymbol : public StationSymbol {
 
 		void setColor(QColor c);
 		void setColorFromValue(double value);
-		QColor color() const { return _color; }
+		QColor color() const;
+		QColor fill() const override;
 
-		void setValue(double v) { _value = v; }
-		double value() const { return _value; }
+		void setValue(double v);
+		double value() const;
 
 		void updateColor();
 
-		void setAnnotation(const QString &a) { _annotation->text = a; }
-		const QString &annotation() const { return _annotation->text; }
+		void setAnnotation(const QString &a);
+		QString annotation() const { return _label.text(); }
 
-		void setState(Settings::State state) { _state = state; }
-		Settings::State state() const { return _state; }
+		void setState(Settings::State state);
+		Settings::State state() const;
+
+		/**
+		 * @brief Copies the projected position from the store to the
+		 *        symbol.
+		 */
+		void syncMapPosition();
 
 		void calculateMapPosition(const Seiscomp::Gui::Map::Canvas *canvas) override;
-		void customDraw(const Seiscomp::Gui::Map::Canvas *canvas, QPainter& painter) override;
 
 
 	private:
-		Seiscomp::Gui::Map::AnnotationItem *_annotation;
+		StationSymbolStore &store() const;
+		void buildLabels();
+
+	private:
 		DataModel::Station                 *_model;
 		Settings::StationData              *_data;
 		bool                                _selected;
-		double                              _value;
-		QColor                              _color;
 		NetworkLayer                       *_layer;
-		Settings::State                     _state;
+		int                                 _index;
+		//! The annotation texts with and without the channel code
+		QString                             _stationLabel;
+		QString                             _channelLabel;
+		//! The annotation text, shaped once and then drawn from the cache
+		QStaticText                         _label;
+		//! The cached label rectangle relative to the label anchor
+		QRect                               _labelExtent;
 
 	friend class NetworkLayer;
 };
@@ -112,13 +183,19 @@ class NetworkLayerLegend : public Gui::Map::Legend {
 		void updateFrom(NetworkLayer *layer);
 
 	private:
+		//! Measures the items and updates the layout and the cache
+		void itemsChanged();
 		void updateLayout();
+		void drawContent(const QRect &rect, QPainter &painter);
 
 	private:
 		QVector< QPair<QString, QColor> > _items;
 		int                               _columns;
 		int                               _columnWidth;
 		int                               _maxColumns;
+		//! The maximum text width of all items
+		int                               _itemWidth{0};
+		LegendCache                       _cache;
 };
 
 
@@ -161,12 +238,10 @@ class NetworkLayer : public Gui::Map::Layer {
 		 *        inventory where the epoch is open or valid for a passed
 		 *        reference time.
 		 * @param inv The inventory pointer
-		 * @param annotations Instance to add station annotations to
 		 * @param time The reference time for which the station must be
 		 *             operational
 		 */
 		void setInventory(DataModel::Inventory *inv,
-		                  Gui::Map::Annotations *annotations,
 		                  const Core::Time *time = nullptr);
 
 		/**
@@ -185,6 +260,9 @@ class NetworkLayer : public Gui::Map::Layer {
 
 		const NetworkLayerGradient *qcGradient() const;
 
+		//! Returns the gradient of the current color mode if any
+		const NetworkLayerGradient *activeGradient() const { return _activeGradient; }
+
 		/**
 		 * @brief Sets the station symbol color mode.
 		 * @param mode The mode flag
@@ -199,10 +277,39 @@ class NetworkLayer : public Gui::Map::Layer {
 
 		void setStationsVisible(QSet<const DataModel::Station *> *);
 
+		/**
+		 * @brief Sets the minimum distance of cluster symbols on screen.
+		 * @param pixels The distance in pixels
+		 */
+		void setClusterDistance(int pixels);
+
+		/**
+		 * @brief Sets if the static symbols should be rasterized in tiles
+		 *        in parallel on the global thread pool. The default is
+		 *        false.
+		 * @param enable The tiled rendering state
+		 */
+		void setTiledRendering(bool enable);
+
 		Gui::Map::Legend *mainLegend() const;
 
 		void updateStation(const std::string &staID);
 
+		/**
+		 * @brief Registers the trigger of a station after its trigger
+		 *        time has been updated. Only registered stations are
+		 *        animated by tick().
+		 * @param data The station data holding the trigger time
+		 */
+		void updateTrigger(Settings::StationData *data);
+
+		/**
+		 * @brief Draws the labels placed with the last draw() call. This
+		 *        is called by StationLabelLayer to draw the labels on top
+		 *        of the following layers.
+		 */
+		void drawLabels(QPainter &p) const;
+
 
 	// ----------------------------------------------------------------------
 	//  Signals
@@ -239,11 +346,37 @@ class NetworkLayer : public Gui::Map::Layer {
 		void setShowUnbound(bool enable);
 
 		/**
-		 * @brief Updates the internal render state for each station symbol.
+		 * @brief Sets if station annotations are shown. Labels are only
+		 *        placed if enabled. The default is true.
+		 * @param enable The visibility state
+		 */
+		void setShowAnnotations(bool enable);
+
+		/**
+		 * @brief Sets if nearby stations should be aggregated into cluster
+		 *        symbols if the map is zoomed out. The default is false.
+		 * @param enable The clustering state
+		 */
+		void setClusteringEnabled(bool enable);
+
+		/**
+		 * @brief Updates the internal render state for each triggered
+		 *        station symbol.
 		 */
 		void tick();
 
 
+	// ----------------------------------------------------------------------
+	//  Private slots
+	// ----------------------------------------------------------------------
+	private slots:
+		/**
+		 * @brief Resets all triggers whose timeout has elapsed and
+		 *        schedules the next expiry.
+		 */
+		void expireTriggers();
+
+
 	// ----------------------------------------------------------------------
 	//  Layer interface
 	// ----------------------------------------------------------------------
@@ -271,6 +404,123 @@ class NetworkLayer : public Gui::Map::Layer {
 		void updateAnnotations();
 		void disposeSymbols();
 		void updateColor(NetworkLayerSymbol *symbol);
+		void updateActiveGradient();
+
+		/**
+		 * @brief Marks the priority buckets as outdated. They will be
+		 *        rebuilt with the next draw or hit test.
+		 */
+		void invalidateBuckets();
+		void updateBuckets();
+
+		/**
+		 * @brief Changes the priority of a symbol and moves it into the
+		 *        corresponding bucket.
+		 * @return true if the priority has changed, false otherwise
+		 */
+		bool setSymbolPriority(NetworkLayerSymbol *symbol,
+		                       Gui::Map::Symbol::Priority priority);
+
+		void updateIssueIcons(QPainter &painter);
+
+		/**
+		 * @brief Adds a symbol with a trigger time to the active set and
+		 *        queues its expiry.
+		 */
+		void activateTrigger(NetworkLayerSymbol *symbol);
+		void resetTrigger(NetworkLayerSymbol *symbol);
+		void scheduleExpiry();
+
+		/**
+		 * @brief Marks the offscreen raster of the static symbols as
+		 *        outdated, e.g. after the projection or a symbol has
+		 *        changed.
+		 */
+		void invalidateStaticLayer();
+
+		/**
+		 * @brief Renders all symbols which are not triggered into the
+		 *        offscreen raster if it is outdated or does not match the
+		 *        target device anymore.
+		 */
+		void updateStaticLayer(const Gui::Map::Canvas *canvas,
+		                       QPainter &p, bool showIssues);
+
+		/**
+		 * @brief Called by a symbol whose color has changed to mark the
+		 *        clusters it belongs to as outdated.
+		 */
+		void symbolChanged(NetworkLayerSymbol *symbol);
+
+		/**
+		 * @brief Returns whether symbol a should rather represent a cluster
+		 *        than symbol b with respect to the current color mode.
+		 */
+		bool isMoreSignificant(const NetworkLayerSymbol *a,
+		                       const NetworkLayerSymbol *b) const;
+
+		void updateCluster(StationClusterIndex::Cluster &cluster);
+
+		//! A drawing primitive of the static layer
+		struct RasterItem {
+			enum Type {
+				Sprite,
+				Issue,
+				Count
+			};
+
+			Type   type{Sprite};
+			//! Sprite: the top left corner, Issue: the circle center
+			QPoint pos;
+			//! The bounds in layer coordinates, Count: the text rectangle
+			QRect  bounds;
+			//! Sprite: the symbol image, Issue: the icon
+			QImage image;
+			//! Issue: the circle radius, Count: the number of stations
+			int    value{0};
+			//! Count: the text color
+			QColor color;
+		};
+
+		/**
+		 * @brief Collects the drawing primitives of all static symbols
+		 *        in drawing order.
+		 */
+		void collectStaticItems(QPainter &p, bool showIssues);
+		void addSymbolItems(const StationSymbol *symbol, Settings::State state,
+		                    qreal dpr, bool antialiasing);
+		bool issueItem(RasterItem &item, const StationSymbol *symbol,
+		               Settings::State state) const;
+
+		/**
+		 * @brief Draws a primitive. This is called concurrently by the
+		 *        tile renderer threads and must not modify the layer.
+		 */
+		void drawItem(QPainter &p, const RasterItem &item) const;
+
+		/**
+		 * @brief Renders the collected primitives into tiles on the
+		 *        global thread pool and composites them with the painter.
+		 */
+		void rasterizeTiles(QPainter &painter);
+
+		void drawIssue(QPainter &p, const StationSymbol *symbol,
+		               Settings::State state);
+
+		void setSymbolVisible(NetworkLayerSymbol *symbol, bool visible);
+
+		/**
+		 * @brief Marks the label placement as outdated, e.g. after the
+		 *        projection or the set of visible symbols has changed.
+		 */
+		void invalidateLabels();
+
+		/**
+		 * @brief Places the labels of all visible symbols in order of
+		 *        their importance. Labels which overlap already placed
+		 *        labels are moved around their symbol or hidden.
+		 */
+		void updateLabels(QPainter &p);
 
 
 	// ----------------------------------------------------------------------
@@ -278,14 +528,67 @@ class NetworkLayer : public Gui::Map::Layer {
 	// ----------------------------------------------------------------------
 	private:
 		using Symbols = QVector<NetworkLayerSymbol*>;
+
+		struct PlacedLabel {
+			const NetworkLayerSymbol *symbol;
+			QRect                     rect;
+		};
+
+		struct TriggerExpiry {
+			bool operator>(const TriggerExpiry &other) const {
+				return time > other.time;
+			}
+
+			Core::Time          time;
+			NetworkLayerSymbol *symbol;
+		};
+
+		//! Min heap of trigger expiries. Entries whose time does not match
+		//! the current trigger time of the symbol are outdated and skipped.
+		using TriggerExpiries = std::priority_queue<
+			TriggerExpiry, std::vector<TriggerExpiry>, std::greater<TriggerExpiry>
+		>;
 		using StationSymbolMap = std::map<std::string, NetworkLayerSymbol*>;
 
+		static const int PriorityCount = Gui::Map::Symbol::HIGH + 1;
+		static const int StateCount = Settings::QCError + 1;
+
 		bool                                     _showChannelCodes;
 		bool                                     _showIssues;
 		bool                                     _showUnbound{true};
+		bool                                     _showAnnotations{true};
 		ColorMode                                _colorMode;
 		std::string                              _activeQCParameter;
-		Symbols                                  _stationSymbols;
+		//! The render state of all stations sorted top to bottom
+		StationSymbolStore                       _store;
+		//! Visible and unclipped symbols per priority sorted top to bottom
+		Symbols                                  _priorityBuckets[PriorityCount];
+		bool                                     _bucketsDirty{true};
+		QImage                                   _issueIcons[StateCount];
+		qreal                                    _issueIconsDPR{0};
+		int                                      _issueIconsFontHeight{0};
+		//! Symbols with an active or pending trigger
+		QSet<NetworkLayerSymbol*>                _triggeredSymbols;
+		TriggerExpiries                          _triggerExpiries;
+		QTimer                                   _expiryTimer;
+		//! Offscreen raster of all symbols except the triggered ones
+		QImage                                   _staticLayer;
+		bool                                     _staticLayerDirty{true};
+		bool                                     _tiledRendering{false};
+		std::vector<RasterItem>                  _rasterItems;
+		QFont                                    _countFont;
+		StationClusterIndex                      _clusterIndex;
+		bool                                     _clustering{false};
+		bool                                     _clusterIndexDirty{true};
+		int                                      _clusterDistance{30};
+		//! The active cluster level or -1 if clustering is not active
+		int                                      _clusterLevel{-1};
+		LabelPlacer                              _labelPlacer;
+		bool                                     _labelsDirty{true};
+		//! The placed labels in drawing order
+		std::vector<PlacedLabel>                 _labels;
+		//! The font the cached label extents have been measured with
+		QFont                                    _labelFont;
 		NetworkColors                            _networkColors;
 		StationSymbolMap                         _stationSymbolLookup;
 		NetworkLayerSymbol                      *_currentSymbol;
@@ -293,11 +596,43 @@ class NetworkLayer : public Gui::Map::Layer {
 		NetworkLayerLegend                      *_legend;
 		NetworkLayerGradient                     _gmGradient;
 		QMap<std::string, NetworkLayerGradient>  _qcGradients;
+		const NetworkLayerGradient              *_activeGradient{nullptr};
 
 		mutable NetworkLayerSymbol              *_isInsideSymbol;
+
+	friend class NetworkLayerSymbol;
 };
 
 
+inline StationSymbolStore &NetworkLayerSymbol::store() const {
+	return _layer->_store;
+}
+
+inline QColor NetworkLayerSymbol::color() const {
+	return QColor::fromRgba(store().color[_index]);
+}
+
+inline QColor NetworkLayerSymbol::fill() const {
+	return color();
+}
+
+inline void NetworkLayerSymbol::setValue(double v) {
+	store().value[_index] = v;
+}
+
+inline double NetworkLayerSymbol::value() const {
+	return store().value[_index];
+}
+
+inline void NetworkLayerSymbol::setState(Settings::State state) {
+	store().state[_index] = static_cast<quint8>(state);
+}
+
+inline Settings::State NetworkLayerSymbol::state() const {
+	return static_cast<Settings::State>(store().state[_index]);
+}
+
+
 }
 
 
@@ -0,0 +1,118 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+#ifndef SEISCOMP_MAPVIEWX_PARALLEL_H
+#define SEISCOMP_MAPVIEWX_PARALLEL_H
+
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+
+namespace Seiscomp::MapViewX {
+
+
+namespace Detail {
+
+
+class Task : public QRunnable {
+	public:
+		explicit Task(std::function<void()> func) : _func(std::move(func)) {}
+
+	public:
+		void run() override { _func(); }
+
+	private:
+		std::function<void()> _func;
+};
+
+
+}
+
+
+/**
+ * @brief Calls func(i) for all i in [0, count) using the global thread
+ *        pool. The calling thread takes part in the work and the function
+ *        returns after all calls have finished. The order of the calls is
+ *        undefined, func must be safe to be called concurrently for
+ *        different indexes.
+ *
+ * The caller only waits for work items being processed by other threads,
+ * not for posted tasks that have not been started yet. Tasks starting
+ * late find no work left and return immediately. This keeps the caller
+ * from stalling on a busy pool and allows calls from pool threads.
+ *
+ * @param count The number of work items
+ * @param func The function to be called for each work item
+ */
+template <typename F>
+void parallelFor(int count, F func) {
+	QThreadPool *pool = QThreadPool::globalInstance();
+	int threads = qMin(count, pool->maxThreadCount());
+
+	if ( threads <= 1 ) {
+		for ( int i = 0; i < count; ++i ) {
+			func(i);
+		}
+		return;
+	}
+
+	// Shared with the tasks which might outlive this call
+	struct State {
+		State(int count, F func) : count(count), func(std::move(func)) {}
+
+		void work() {
+			int i;
+			while ( (i = next.fetch_add(1)) < count ) {
+				func(i);
+				if ( finished.fetch_add(1) + 1 == count ) {
+					done.release();
+				}
+			}
+		}
+
+		const int         count;
+		F                 func;
+		std::atomic<int>  next{0};
+		std::atomic<int>  finished{0};
+		QSemaphore        done;
+	};
+
+	auto state = std::make_shared<State>(count, std::move(func));
+
+	for ( int t = 1; t < threads; ++t ) {
+		pool->start(new Detail::Task([state]() {
+			state->work();
+		}));
+	}
+
+	state->work();
+	state->done.acquire();
+}
+
+}
+
+
+#endif
@@ -0,0 +1,189 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+#include <seiscomp/gui/map/canvas.h>
+#include <seiscomp/gui/map/projection.h>
+
+#include <cmath>
+
+#include "networklayer.h"
+#include "stationcluster.h"
+
+
+namespace Seiscomp::MapViewX {
+
+
+namespace {
+
+
+const double Level0CellSize = 45.0;
+
+
+inline double cellSize(int level) {
+	return Level0CellSize / (1 << level);
+}
+
+
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void StationClusterIndex::clear() {
+	for ( auto &level : _levels ) {
+		level.clear();
+	}
+
+	_slots.clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void StationClusterIndex::build(const std::vector<NetworkLayerSymbol*> &symbols) {
+	clear();
+
+	_slots.reserve(symbols.size());
+
+	for ( int l = 0; l < Levels; ++l ) {
+		double size = cellSize(l);
+		qint64 columns = static_cast<qint64>(ceil(360.0 / size));
+		std::unordered_map<qint64, int> cells;
+		auto &clusters = _levels[l];
+
+		for ( auto symbol : symbols ) {
+			double lon = symbol->longitude();
+			double lat = symbol->latitude();
+
+			// Normalize the longitude to [-180,180)
+			lon = fmod(lon + 180.0, 360.0);
+			if ( lon < 0 ) {
+				lon += 360.0;
+			}
+
+			qint64 ix = static_cast<qint64>(lon / size);
+			qint64 iy = static_cast<qint64>((qBound(-90.0, lat, 90.0) + 90.0) / size);
+			qint64 key = iy * columns + ix;
+
+			auto it = cells.find(key);
+			int idx;
+
+			if ( it == cells.end() ) {
+				idx = static_cast<int>(clusters.size());
+				cells[key] = idx;
+				clusters.emplace_back();
+			}
+			else {
+				idx = it->second;
+			}
+
+			auto &cluster = clusters[idx];
+			cluster.members.append(symbol);
+			// Accumulate and normalize after all members have been added
+			cluster.location += QPointF(symbol->longitude(), symbol->latitude());
+
+			_slots[symbol][l] = idx;
+		}
+
+		for ( auto &cluster : clusters ) {
+			cluster.location /= cluster.members.size();
+		}
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void StationClusterIndex::invalidate() {
+	for ( auto &level : _levels ) {
+		for ( auto &cluster : level ) {
+			cluster.dirty = true;
+		}
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void StationClusterIndex::invalidate(const NetworkLayerSymbol *symbol) {
+	auto it = _slots.find(symbol);
+	if ( it == _slots.end() ) {
+		return;
+	}
+
+	for ( int l = 0; l < Levels; ++l ) {
+		_levels[l][it->second[l]].dirty = true;
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+int StationClusterIndex::selectLevel(double pixelPerDegree, int distance) {
+	// Zoomed in far enough that even the finest cells are larger than
+	// the cluster distance: show all stations individually
+	if ( cellSize(Levels - 1) * pixelPerDegree >= distance ) {
+		return -1;
+	}
+
+	// Select the finest level whose cells are not smaller than the
+	// distance
+	for ( int l = Levels - 2; l > 0; --l ) {
+		if ( cellSize(l) * pixelPerDegree >= distance ) {
+			return l;
+		}
+	}
+
+	return 0;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void StationClusterIndex::calculateMapPosition(int level, const Gui::Map::Canvas *canvas) {
+	QPoint pos;
+
+	for ( auto &cluster : _levels[level] ) {
+		cluster.clipped = !canvas->projection()->project(pos, cluster.location);
+		if ( cluster.symbol ) {
+			cluster.symbol->calculateMapPosition(canvas);
+		}
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -0,0 +1,141 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+#ifndef SEISCOMP_MAPVIEWX_STATIONCLUSTER_H
+#define SEISCOMP_MAPVIEWX_STATIONCLUSTER_H
+
+
+#include <QPointF>
+#include <QVector>
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "../settings.h"
+#include "stationsymbol.h"
+
+
+namespace Seiscomp {
+
+namespace Gui::Map {
+
+class Canvas;
+
+}
+
+namespace MapViewX {
+
+
+class NetworkLayerSymbol;
+
+
+/**
+ * @brief Hierarchical grid index of station symbols used to aggregate
+ *        nearby stations into clusters at low zoom levels.
+ *
+ * Level 0 divides the globe into cells of 45 degrees, each following
+ * level halves the cell size. The cell membership of a station is
+ * computed once when the index is built. Aggregated values of a cluster
+ * are only recomputed if a member has changed.
+ */
+class StationClusterIndex {
+	// ----------------------------------------------------------------------
+	//  Public types
+	// ----------------------------------------------------------------------
+	public:
+		static const int Levels = 8;
+
+		struct Cluster {
+			//! The mean location of all members as (lon, lat)
+			QPointF                         location;
+			//! Whether location is outside the visible map area
+			bool                            clipped{true};
+			//! Whether the aggregated values need to be recomputed
+			bool                            dirty{true};
+			//! The number of visible members
+			int                             count{0};
+			//! The worst state of all visible members
+			Settings::State                 state{Settings::OK};
+			//! The member whose color represents the cluster
+			NetworkLayerSymbol             *representative{nullptr};
+			QVector<NetworkLayerSymbol*>    members;
+			//! The cluster symbol, created on demand if count > 1
+			std::unique_ptr<StationSymbol>  symbol;
+		};
+
+		using Clusters = std::vector<Cluster>;
+
+
+	// ----------------------------------------------------------------------
+	//  Public interface
+	// ----------------------------------------------------------------------
+	public:
+		void clear();
+
+		/**
+		 * @brief Rebuilds the index from the passed symbols.
+		 */
+		void build(const std::vector<NetworkLayerSymbol*> &symbols);
+
+		/**
+		 * @brief Marks all clusters of all levels as dirty, e.g. after
+		 *        the visibility of symbols has changed.
+		 */
+		void invalidate();
+
+		/**
+		 * @brief Marks all clusters the symbol belongs to as dirty.
+		 */
+		void invalidate(const NetworkLayerSymbol *symbol);
+
+		/**
+		 * @brief Returns the level whose cells are at least distance
+		 *        pixels wide on screen for the given scale.
+		 * @return The level or -1 if the map is zoomed in far enough to
+		 *         show all symbols individually.
+		 */
+		static int selectLevel(double pixelPerDegree, int distance);
+
+		/**
+		 * @brief Projects the cluster locations and symbols of a level.
+		 */
+		void calculateMapPosition(int level, const Gui::Map::Canvas *canvas);
+
+		Clusters &clusters(int level) { return _levels[level]; }
+
+
+	// ----------------------------------------------------------------------
+	//  Private members
+	// ----------------------------------------------------------------------
+	private:
+		using Slots = std::array<int, Levels>;
+
+		Clusters                                                 _levels[Levels];
+		std::unordered_map<const NetworkLayerSymbol*, Slots>     _slots;
+};
+
+
+}
+}
+
+
+#endif
@@ -0,0 +1,60 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+
+#ifndef SEISCOMP_MAPVIEWX_LAYERS_STATIONLABELLAYER_H
+#define SEISCOMP_MAPVIEWX_LAYERS_STATIONLABELLAYER_H
+
+
+#include <seiscomp/gui/map/layer.h>
+
+
+namespace Seiscomp::MapViewX {
+
+
+class NetworkLayer;
+
+
+/**
+ * @brief Draws the station labels placed by a network layer.
+ *
+ * The labels are placed by the network layer while drawing the station
+ * symbols. This layer only draws them on top of the layers added after
+ * the network layer, e.g. the event symbols.
+ */
+class StationLabelLayer : public Gui::Map::Layer {
+	Q_OBJECT
+
+	public:
+		StationLabelLayer(NetworkLayer *stations, QObject *parent = nullptr);
+
+	public:
+		void draw(const Gui::Map::Canvas*, QPainter &p) override;
+
+
+	private:
+		NetworkLayer *_stations;
+};
+
+
+}
+
+
+#endif
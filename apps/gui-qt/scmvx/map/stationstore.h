@@ -0,0 +1,114 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+#ifndef SEISCOMP_MAPVIEWX_STATIONSTORE_H
+#define SEISCOMP_MAPVIEWX_STATIONSTORE_H
+
+
+#include <QColor>
+
+#include <vector>
+
+
+namespace Seiscomp::MapViewX {
+
+
+class NetworkLayerSymbol;
+
+
+/**
+ * @brief Structure of arrays holding the per station render state of the
+ *        network layer.
+ *
+ * Each station occupies one slot in all arrays. Slots are ordered top to
+ * bottom, which is the drawing order of the symbols. Projection, culling
+ * and color updates loop over the arrays, the symbol objects only act as
+ * views into their slot. Colors, values and states are held only here.
+ * Positions, clipping, visibility and priorities are mirrored by the
+ * symbols, see NetworkLayerSymbol.
+ */
+class StationSymbolStore {
+	// ----------------------------------------------------------------------
+	//  Public types
+	// ----------------------------------------------------------------------
+	public:
+		enum Flag {
+			Visible = 0x01,
+			Clipped = 0x02
+		};
+
+
+	// ----------------------------------------------------------------------
+	//  Public interface
+	// ----------------------------------------------------------------------
+	public:
+		void clear();
+		void reserve(int n);
+
+		/**
+		 * @brief Appends a slot for a station at the given location.
+		 * @return The slot index
+		 */
+		int append(double latitude, double longitude);
+
+		int size() const { return static_cast<int>(latitude.size()); }
+
+		void setFlag(int index, Flag flag, bool enable) {
+			if ( enable )
+				flags[index] |= flag;
+			else
+				flags[index] &= ~flag;
+		}
+
+		bool testFlag(int index, Flag flag) const {
+			return flags[index] & flag;
+		}
+
+		//! Returns whether a slot is visible and not clipped
+		bool isDrawable(int index) const {
+			return (flags[index] & (Visible | Clipped)) == Visible;
+		}
+
+
+	// ----------------------------------------------------------------------
+	//  Public members
+	// ----------------------------------------------------------------------
+	public:
+		std::vector<double>               latitude;
+		std::vector<double>               longitude;
+		//! The projected screen coordinates
+		std::vector<int>                  x;
+		std::vector<int>                  y;
+		//! The fill colors as packed ARGB
+		std::vector<QRgb>                 color;
+		std::vector<double>               value;
+		//! Settings::State
+		std::vector<quint8>               state;
+		//! Gui::Map::Symbol::Priority
+		std::vector<quint8>               priority;
+		std::vector<quint8>               flags;
+		std::vector<NetworkLayerSymbol*>  symbols;
+};
+
+
+}
+
+
+#endif
@@ -27,6 +27,11 @@
 #include "stationsymbol.h"
 
 #include <QMutex>
+#include <QPainter>
+
+#include <cmath>
+#include <map>
+#include <tuple>
 
 
 namespace Seiscomp::MapViewX {
@@ -124,6 +129,151 @@ class ShapeCache : public QMap<int, QPair<int, QPolygon*> > {
 ShapeCache shapeCache;
 
 
+const int ShadowBlurRadius = 1;
+const size_t MaxSprites = 4096;
+
+
+struct SpriteKey {
+	int  width;
+	int  frameSize;
+	QRgb fill;
+	QRgb pen;
+	QRgb frame;
+	int  penWidth;
+	int  dpr;
+	bool antialiasing;
+
+	bool operator<(const SpriteKey &other) const {
+		return std::tie(width, frameSize, fill, pen, frame, penWidth, dpr, antialiasing)
+		     < std::tie(other.width, other.frameSize, other.fill, other.pen,
+		                other.frame, other.penWidth, other.dpr, other.antialiasing);
+	}
+};
+
+
+struct Sprite {
+	QImage image;
+	QPoint offset;
+};
+
+
+/**
+ * @brief Renders each distinct station symbol variant once and keeps the
+ *        resulting image. Symbols are then drawn with a single blit.
+ */
+class SpriteAtlas : public std::map<SpriteKey, Sprite> {
+	public:
+		const Sprite &sprite(const SpriteKey &key,
+		                     const QPolygon &shape,
+		                     const QPolygon *frame,
+		                     qreal penWidth, qreal dpr) {
+			if ( auto it = find(key); it != end() ) {
+				return it->second;
+			}
+
+			if ( size() >= MaxSprites ) {
+				SEISCOMP_DEBUG("Station sprite atlas full, flush %d entries",
+				               static_cast<int>(size()));
+				clear();
+			}
+
+			return emplace(key, render(key, shape, frame, penWidth, dpr)).first->second;
+		}
+
+
+	private:
+		static Sprite render(const SpriteKey &key,
+		                     const QPolygon &shape,
+		                     const QPolygon *frame,
+		                     qreal penWidth, qreal dpr) {
+			int penMargin = static_cast<int>(ceil(penWidth)) + 1;
+			int dim = key.width * 2 + ShadowBlurRadius * 2;
+
+			QRect shadowRect(-ShadowBlurRadius, -dim + ShadowBlurRadius, dim, dim);
+			QRect rect = shape.boundingRect().adjusted(-penMargin, -penMargin, penMargin, penMargin);
+
+			if ( frame ) {
+				rect |= frame->boundingRect()
+				        .translated(0, key.frameSize)
+				        .adjusted(-penMargin, -penMargin, penMargin, penMargin);
+			}
+
+			rect |= shadowRect;
+
+			Sprite sprite;
+			sprite.offset = rect.topLeft();
+			sprite.image = QImage(rect.size() * dpr, QImage::Format_ARGB32_Premultiplied);
+			sprite.image.setDevicePixelRatio(dpr);
+			sprite.image.fill(Qt::transparent);
+
+			// Render the shadow separately to blur it before it is composed
+			// into the sprite.
+			QImage shadow(QSize(dim, dim) * dpr, QImage::Format_ARGB32);
+			shadow.fill(0);
+
+			{
+				QPainter p(&shadow);
+				p.setRenderHint(QPainter::Antialiasing);
+				p.setPen(Qt::NoPen);
+				p.setBrush(QColor(64, 64, 64, 160));
+
+				p.scale(dpr, dpr);
+				p.translate(ShadowBlurRadius, dim - ShadowBlurRadius);
+				p.scale(0.7, 0.5);
+				p.shear(-1, 0.2);
+				p.drawPolygon(shape);
+			}
+
+			blurImage(shadow, qMax(1, static_cast<int>(ShadowBlurRadius * dpr)));
+			shadow.setDevicePixelRatio(dpr);
+
+			QPainter painter(&sprite.image);
+			painter.setRenderHint(QPainter::Antialiasing, key.antialiasing);
+			painter.translate(-sprite.offset);
+
+			painter.drawImage(shadowRect.topLeft(), shadow);
+
+			QPen pen(Qt::MiterJoin);
+			QBrush brush(Qt::SolidPattern);
+
+			if ( frame ) {
+				QColor frameColor = QColor::fromRgba(key.frame);
+				painter.setPen(frameColor);
+				brush.setColor(frameColor);
+				painter.setBrush(brush);
+
+				painter.translate(0, key.frameSize);
+				painter.drawPolygon(*frame);
+				painter.translate(0, -key.frameSize);
+			}
+
+			pen.setWidthF(penWidth);
+			pen.setColor(QColor::fromRgba(key.pen));
+			painter.setPen(pen);
+
+			brush.setColor(QColor::fromRgba(key.fill));
+			painter.setBrush(brush);
+
+			painter.drawPolygon(shape);
+
+			return sprite;
+		}
+};
+
+
+SpriteAtlas spriteAtlas;
+
+
+QRgb quantizedAlpha(const QColor &color) {
+	// Frame colors fade out with the trigger age. Reduce the alpha to
+	// 16 levels to keep the number of distinct sprites small.
+	QRgb rgba = color.rgba();
+	int alpha = qAlpha(rgba);
+	alpha = alpha < 255 ? (alpha & 0xf0) : alpha;
+	return qRgba(qRed(rgba), qGreen(rgba), qBlue(rgba), alpha);
+}
+
+
 }
 
 
@@ -263,6 +413,21 @@ void StationSymbol::setFrameColor(const QColor &color) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void StationSymbol::setWidth(int w) {
+	if ( _width == w ) {
+		return;
+	}
+
+	// Release the shapes of the old size. Cluster symbols change their
+	// size with the number of members.
+	if ( _stationPolygon ) {
+		shapeCache.dropShape(_width);
+	}
+
+	if ( _framePolygon ) {
+		shapeCache.dropShape(_width + _frameSize * 2);
+		_framePolygon = nullptr;
+	}
+
 	_width = w;
 	_stationPolygon = shapeCache.shape(_width);
 	setFrameSize(_frameSize);
@@ -281,35 +446,28 @@ int StationSymbol::width() const {
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-void StationSymbol::customDraw(const Gui::Map::Canvas *, QPainter &painter) {
+const QImage *StationSymbol::sprite(QPoint &offset, qreal dpr, bool antialiasing) const {
 	if ( !_stationPolygon ) {
-		return;
-	}
-
-	QPen pen(Qt::MiterJoin);
-	QBrush brush(Qt::SolidPattern);
-
-	painter.translate(x(), y());
-
-	if ( _frameSize > 0 ) {
-		painter.setPen(_frameColor);
-		brush.setColor(_frameColor);
-		painter.setBrush(brush);
-
-		painter.translate(0, _frameSize);
-		painter.drawPolygon(*_framePolygon);
-		painter.translate(0, -_frameSize);
+		return nullptr;
 	}
 
-	pen.setWidthF(_penWidth);
-	pen.setColor(_penColor);
-	painter.setPen(pen);
-
-	brush.setColor(_fillColor);
-	painter.setBrush(brush);
-
-	painter.drawPolygon(*_stationPolygon);
-	painter.translate(-x(), -y());
+	bool hasFrame = (_frameSize > 0) && _framePolygon;
+
+	SpriteKey key;
+	key.width = _width;
+	key.frameSize = hasFrame ? _frameSize : 0;
+	key.fill = fill().rgba();
+	key.pen = _penColor.rgba();
+	key.frame = hasFrame ? quantizedAlpha(_frameColor) : 0;
+	key.penWidth = qRound(_penWidth * 100);
+	key.dpr = qRound(dpr * 100);
+	key.antialiasing = antialiasing;
+
+	auto &sprite = spriteAtlas.sprite(key, *_stationPolygon,
+	                                  hasFrame ? _framePolygon : nullptr,
+	                                  _penWidth, dpr);
+	offset = sprite.offset;
+	return &sprite.image;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -317,39 +475,15 @@ void StationSymbol::customDraw(const Gui::Map::Canvas *, QPainter &painter) {
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-void StationSymbol::drawShadow(QPainter &painter) {
-	static int blurRadius = 1;
-	static int shadowCacheSize = -1;
-	static QImage shadowCache;
-
-	if ( !_stationPolygon ) {
+void StationSymbol::customDraw(const Gui::Map::Canvas *, QPainter &painter) {
+	QPoint offset;
+	auto image = sprite(offset, painter.device()->devicePixelRatioF(),
+	                    painter.testRenderHint(QPainter::Antialiasing));
+	if ( !image ) {
 		return;
 	}
 
-	if ( shadowCacheSize != _width ) {
-		int dim = _width * 2 + blurRadius * 2;
-		shadowCache = QImage(dim, dim, QImage::Format_ARGB32);
-
-		shadowCache.fill(0);
-
-		{
-			QPainter p(&shadowCache);
-			p.setRenderHint(QPainter::Antialiasing);
-			p.setPen(Qt::NoPen);
-			p.setBrush(QColor(64, 64, 64, 160));
-
-			p.translate(blurRadius, dim-blurRadius);
-			p.scale(0.7, 0.5);
-			p.shear(-1, 0.2);
-			p.drawPolygon(*_stationPolygon);
-			p.resetTransform();
-		}
-
-		blurImage(shadowCache, blurRadius);
-		shadowCacheSize = _width;
-	}
-
-	painter.drawImage(x() - blurRadius, y() - shadowCache.height() + blurRadius, shadowCache);
+	painter.drawImage(_position + offset, *image);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
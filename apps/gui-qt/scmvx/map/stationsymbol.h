@@ -45,7 +45,9 @@ class StationSymbol : public Gui::Map::Symbol {
 	// ----------------------------------------------------------------------
 	public:
 		void setFill(const QColor &color);
-		QColor fill() const;
+		//! Returns the fill color the symbol is drawn with. Subclasses
+		//! can take it from elsewhere, setFill() is ignored then.
+		virtual QColor fill() const;
 
 		void setPen(const QColor &color);
 		QColor pen() const;
@@ -63,13 +65,25 @@ class StationSymbol : public Gui::Map::Symbol {
 
 		static void generateShape(QPolygon &poly, int posX, int posY, int radius);
 
+		/**
+		 * @brief Returns the pre-rendered sprite of this symbol variant
+		 *        including its shadow. Sprites are shared between all
+		 *        symbols with the same shape, size, colors and frame and
+		 *        rendered only once per device pixel ratio.
+		 * @param offset Returns the offset of the image top left corner
+		 *               relative to the symbol position.
+		 * @param dpr The device pixel ratio of the target device.
+		 * @param antialiasing Whether to render the sprite antialiased.
+		 * @return The sprite image or nullptr if no shape is set.
+		 */
+		const QImage *sprite(QPoint &offset, qreal dpr, bool antialiasing) const;
+
 
 	// ----------------------------------------------------------------------
 	//  Symbol interface
 	// ----------------------------------------------------------------------
 	public:
 		bool isInside(int x, int y) const override;
-		virtual void drawShadow(QPainter &painter);
 
 
 	protected:
@@ -0,0 +1,340 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+#define SEISCOMP_COMPONENT MapView
+#include <seiscomp/logging/log.h>
+#include <seiscomp/math/geo.h>
+#include <seiscomp/seismology/ttt.h>
+#include <seiscomp/gui/map/canvas.h>
+#include <seiscomp/gui/map/projection.h>
+
+#include <QPainter>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+
+#include "wavefrontdecorator.h"
+
+
+namespace Seiscomp::MapViewX {
+
+
+namespace {
+
+
+const double MaximumDistance = 180.0;
+const double DepthBinSize = 10.0;
+const double MaximumDepth = 700.0;
+const int CircleSegments = 180;
+
+
+void fillTable(std::vector<float> &times, const char *phase,
+               TravelTimeTableInterface *ttt, double depth) {
+	int samples = static_cast<int>(MaximumDistance / WavefrontTable::DistanceStep) + 1;
+	times.reserve(samples);
+
+	for ( int i = 0; i < samples; ++i ) {
+		double distance = i * WavefrontTable::DistanceStep;
+		double time;
+
+		try {
+			if ( phase ) {
+				time = ttt->compute(phase, 0, 0, depth, 0, distance).time;
+			}
+			else {
+				time = ttt->computeFirst(0, 0, depth, 0, distance).time;
+			}
+		}
+		catch ( ... ) {
+			// The phase is not available beyond this distance
+			break;
+		}
+
+		// Keep the table monotonic for the inverse lookup
+		if ( !times.empty() ) {
+			time = std::max(time, static_cast<double>(times.back()));
+		}
+
+		times.push_back(static_cast<float>(time));
+	}
+}
+
+
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const WavefrontTable &WavefrontTable::get(double depth) {
+	// Only accessed from the GUI thread
+	static std::map<int, WavefrontTable> tables;
+
+	int bin = static_cast<int>(std::round(qBound(0.0, depth, MaximumDepth) / DepthBinSize));
+	auto it = tables.find(bin);
+	if ( it != tables.end() ) {
+		return it->second;
+	}
+
+	WavefrontTable &table = tables[bin];
+
+	TravelTimeTableInterfacePtr ttt = TravelTimeTableInterface::Create("libtau");
+	if ( !ttt || !ttt->setModel("iasp91") ) {
+		SEISCOMP_WARNING("Unable to create travel time table libtau/iasp91, "
+		                 "wavefronts are disabled");
+		return table;
+	}
+
+	// First arrivals for P, e.g. Pdiff and PKP at large distances
+	fillTable(table.p, nullptr, ttt.get(), bin * DepthBinSize);
+	fillTable(table.s, "S", ttt.get(), bin * DepthBinSize);
+
+	SEISCOMP_DEBUG("Computed wavefront table for depth %.0f km", bin * DepthBinSize);
+
+	return table;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+double WavefrontTable::distance(const std::vector<float> &times, double t) {
+	if ( times.empty() || t > times.back() ) {
+		return -1;
+	}
+
+	if ( t <= times.front() ) {
+		return 0;
+	}
+
+	// times[i-1] < t <= times[i]
+	auto it = std::lower_bound(times.begin(), times.end(), static_cast<float>(t));
+	auto i = it - times.begin();
+	if ( i == 0 ) {
+		return 0;
+	}
+
+	double t0 = times[i-1];
+	double t1 = times[i];
+	double f = t1 > t0 ? (t - t0) / (t1 - t0) : 1.0;
+
+	return (i - 1 + f) * DistanceStep;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+double WavefrontTable::duration() const {
+	double duration = 0;
+
+	if ( !p.empty() ) {
+		duration = std::max(duration, static_cast<double>(p.back()));
+	}
+
+	if ( !s.empty() ) {
+		duration = std::max(duration, static_cast<double>(s.back()));
+	}
+
+	return duration;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WavefrontDecorator::setLatitude(double latitude) {
+	if ( latitude != _latitude ) {
+		_latitude = latitude;
+		invalidate();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WavefrontDecorator::setLongitude(double longitude) {
+	if ( longitude != _longitude ) {
+		_longitude = longitude;
+		invalidate();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WavefrontDecorator::setDepth(double depth) {
+	const WavefrontTable *table = &WavefrontTable::get(depth);
+	if ( table != _table ) {
+		_table = table;
+		invalidate();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WavefrontDecorator::setOriginTime(const Core::Time &time) {
+	_originTime = time;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool WavefrontDecorator::isExpired() const {
+	if ( !_table ) {
+		return false;
+	}
+
+	return (Core::Time::UTC() - _originTime).length() > _table->duration();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WavefrontDecorator::invalidate() {
+	_p.distance = _s.distance = -1;
+	_p.polygons.clear();
+	_s.polygons.clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WavefrontDecorator::updateWavefront(const Gui::Map::Canvas *canvas,
+                                         Wavefront &front, double distance,
+                                         bool force) {
+	if ( !force && distance == front.distance ) {
+		return;
+	}
+
+	front.distance = distance;
+	front.polygons.clear();
+
+	if ( distance <= 0 ) {
+		return;
+	}
+
+	auto projection = canvas->projection();
+	int halfWidth = canvas->width() / 2;
+	QPolygon polygon;
+
+	auto flush = [&front, &polygon]() {
+		if ( polygon.size() > 1 ) {
+			front.polygons.append(polygon);
+		}
+		polygon.clear();
+	};
+
+	for ( int i = 0; i <= CircleSegments; ++i ) {
+		double lat, lon;
+		Math::Geo::delandaz2coord(distance, i * 360.0 / CircleSegments,
+		                          _latitude, _longitude, &lat, &lon);
+
+		QPoint pos;
+		if ( !projection->project(pos, QPointF(lon, lat)) ) {
+			// Split the line at points on the invisible hemisphere
+			flush();
+			continue;
+		}
+
+		// Split the line where it wraps around the map
+		if ( !polygon.isEmpty() && std::abs(pos.x() - polygon.last().x()) > halfWidth ) {
+			flush();
+		}
+
+		polygon.append(pos);
+	}
+
+	flush();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WavefrontDecorator::customDraw(const Gui::Map::Canvas *canvas, QPainter &painter) {
+	if ( !_table ) {
+		return;
+	}
+
+	// Whole seconds: repaints in between reuse the cached polygons
+	double elapsed = std::floor((Core::Time::UTC() - _originTime).length());
+	if ( elapsed < 0 ) {
+		return;
+	}
+
+	QSize canvasSize(canvas->width(), canvas->height());
+	bool stateChanged = canvas->mapCenter() != _mapCenter
+	                 || canvas->pixelPerDegree() != _pixelPerDegree
+	                 || canvasSize != _canvasSize;
+
+	if ( stateChanged ) {
+		_mapCenter = canvas->mapCenter();
+		_pixelPerDegree = canvas->pixelPerDegree();
+		_canvasSize = canvasSize;
+	}
+
+	updateWavefront(canvas, _p, WavefrontTable::distance(_table->p, elapsed), stateChanged);
+	updateWavefront(canvas, _s, WavefrontTable::distance(_table->s, elapsed), stateChanged);
+
+	painter.save();
+	painter.setRenderHint(QPainter::Antialiasing, true);
+	painter.setBrush(Qt::NoBrush);
+
+	painter.setPen(QPen(QColor(0, 0, 255, 192), 2));
+	for ( const auto &polygon : _p.polygons ) {
+		painter.drawPolyline(polygon);
+	}
+
+	painter.setPen(QPen(QColor(255, 0, 0, 192), 2));
+	for ( const auto &polygon : _s.polygons ) {
+		painter.drawPolyline(polygon);
+	}
+
+	painter.restore();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
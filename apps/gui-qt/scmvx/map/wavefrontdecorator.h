@@ -0,0 +1,143 @@
+/***************************************************************************
+ * Copyright (C) gempa GmbH                                                *
+ * All rights reserved.                                                    *
+ * Contact: gempa GmbH (seiscomp-dev@gempa.de)                             *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ *                                                                         *
+ * Other Usage                                                             *
+ * Alternatively, this file may be used in accordance with the terms and   *
+ * conditions contained in a signed written agreement between you and      *
+ * gempa GmbH.                                                             *
+ ***************************************************************************/
+
+
+#ifndef SEISCOMP_MAPVIEWX_WAVEFRONTDECORATOR_H
+#define SEISCOMP_MAPVIEWX_WAVEFRONTDECORATOR_H
+
+
+#ifndef Q_MOC_RUN
+#include <seiscomp/core/datetime.h>
+#include <seiscomp/gui/map/decorator.h>
+#endif
+
+#include <QPointF>
+#include <QPolygon>
+#include <QSize>
+#include <QVector>
+
+#include <vector>
+
+
+namespace Seiscomp::MapViewX {
+
+
+/**
+ * @brief The first arrival times of P and S for one source depth bin.
+ *
+ * The tables are sampled at fixed epicentral distances and end at the
+ * largest distance the phase is available for. They are computed once per
+ * depth bin and shared by all decorators.
+ */
+struct WavefrontTable {
+	//! The distance between two samples in degrees
+	static constexpr double DistanceStep = 0.5;
+
+	std::vector<float> p;
+	std::vector<float> s;
+
+	/**
+	 * @brief Returns the table of the depth bin the passed depth falls
+	 *        into. The table is computed on first access.
+	 * @param depth The source depth in km
+	 */
+	static const WavefrontTable &get(double depth);
+
+	/**
+	 * @brief Returns the distance a phase has traveled after t seconds.
+	 * @return The distance in degrees or -1 if the phase has left the table
+	 */
+	static double distance(const std::vector<float> &times, double t);
+
+	//! Returns the time after which both phases have left the table
+	double duration() const;
+};
+
+
+/**
+ * @brief Draws the P and S wavefronts of an origin.
+ *
+ * The travel times are looked up in the shared tables of the origin's
+ * depth bin. The wavefront polygons are cached and only recomputed if
+ * the projection state or the traveled distance has changed, which happens
+ * at most once per second of elapsed time.
+ */
+class WavefrontDecorator : public Gui::Map::Decorator {
+	// ----------------------------------------------------------------------
+	//  X'truction
+	// ----------------------------------------------------------------------
+	public:
+		WavefrontDecorator() = default;
+
+
+	// ----------------------------------------------------------------------
+	//  Public interface
+	// ----------------------------------------------------------------------
+	public:
+		void setLatitude(double latitude);
+		void setLongitude(double longitude);
+		void setDepth(double depth);
+		void setOriginTime(const Core::Time &time);
+
+		//! Returns whether both wavefronts have left the travel time tables
+		bool isExpired() const;
+
+
+	// ----------------------------------------------------------------------
+	//  Decorator interface
+	// ----------------------------------------------------------------------
+	protected:
+		void customDraw(const Gui::Map::Canvas *canvas, QPainter &painter) override;
+
+
+	// ----------------------------------------------------------------------
+	//  Private members
+	// ----------------------------------------------------------------------
+	private:
+		struct Wavefront {
+			//! The distance in degrees the polygons were computed for
+			double             distance{-1};
+			QVector<QPolygon>  polygons;
+		};
+
+		void updateWavefront(const Gui::Map::Canvas *canvas, Wavefront &front,
+		                     double distance, bool force);
+		void invalidate();
+
+
+	private:
+		double                 _latitude{0};
+		double                 _longitude{0};
+		const WavefrontTable  *_table{nullptr};
+		Core::Time             _originTime;
+
+		// The projection state the polygons were computed for
+		QPointF                _mapCenter;
+		double                 _pixelPerDegree{0};
+		QSize                  _canvasSize;
+
+		Wavefront              _p;
+		Wavefront              _s;
+};
+
+
+}
+
+
+#endif
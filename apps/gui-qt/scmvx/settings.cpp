@@ -53,6 +53,9 @@ void Settings::accept(System::Application::SettingsLinker &linker) {
 	& cfg(ringBuffer, "stations.groundMotionRecordLifeSpan")
 	& cfg(triggerTimeout, "stations.triggerTimeout")
 	& cfg(triggerFrameSize, "stations.triggerFrameSize")
+	& cfg(stationClustering, "stations.clustering")
+	& cfg(stationClusterDistance, "stations.clusterDistance")
+	& cfg(tiledStationRendering, "stations.tiledRendering")
 	& cfg(eventTimeSpan, "readEventsNotOlderThan")
 	& cfg(centerOrigins, "centerOrigins")
 	& cfg(showLatestEvent, "showLatestEvent")
@@ -63,6 +66,9 @@ void Settings::accept(System::Application::SettingsLinker &linker) {
 	& cfg(annotations, "annotations")
 	& cfg(annotationsWithChannels, "annotationsWithChannels")
 	& cfg(showUnboundStations, "showUnboundStations")
+	& cfg(discardEventDetails, "discardEventDetails")
+	& cfg(inputFileCache, "inputFileCache")
+	& cfg(eventThinningScale, "eventThinningScale")
 	;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -95,6 +95,9 @@ struct Settings : System::Application::AbstractSettings {
 	Core::TimeSpan    ringBuffer{60 * 10, 0};
 	Core::TimeSpan    triggerTimeout{900, 0};
 	int               triggerFrameSize{3};
+	bool              stationClustering{false};
+	int               stationClusterDistance{30};
+	bool              tiledStationRendering{false};
 	bool              tickToggleState{false};
 	bool              centerOrigins{false};
 	std::string       displayMode{"network"};
@@ -105,6 +108,9 @@ struct Settings : System::Application::AbstractSettings {
 	bool              annotations{false};
 	bool              annotationsWithChannels{true};
 	bool              showUnboundStations{true};
+	bool              discardEventDetails{false};
+	bool              inputFileCache{true};
+	double            eventThinningScale{50};
 
 	struct {
 		void accept(System::Application::SettingsLinker &linker) {